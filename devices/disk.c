@@ -32,6 +32,7 @@
 #define STA_BSY 0x80  /* Busy. */
 #define STA_DRDY 0x40 /* Device Ready. */
 #define STA_DRQ 0x08  /* Data Request. */
+#define STA_ERR 0x01  /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04 /* Software Reset. */
@@ -73,6 +74,13 @@ struct channel {
                                                                      any interrupt would be spurious. */
     struct semaphore completion_wait; /* Up'd by interrupt handler. */
 
+    /* A read in progress, which the interrupt handler transfers
+       sector by sector, waking the reader only at the end. */
+    void *const *read_sectors; /* Buffers for the sectors, or NULL. */
+    size_t read_size;          /* Number of sectors to read. */
+    size_t read_done;          /* Number of sectors read so far. */
+    bool read_failed;          /* Did the disk report an error? */
+
     struct disk devices[2]; /* The devices on this channel. */
 };
 
@@ -84,7 +92,7 @@ static void reset_channel(struct channel *);
 static bool check_device_type(struct disk *);
 static void identify_ata_device(struct disk *);
 
-static void select_sector(struct disk *, disk_sector_t);
+static void select_sectors(struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command(struct channel *, uint8_t command);
 static void input_sector(struct channel *, void *);
 static void output_sector(struct channel *, const void *);
@@ -121,6 +129,7 @@ void disk_init(void) {
         lock_init(&c->lock);
         c->expecting_interrupt = false;
         sema_init(&c->completion_wait, 0);
+        c->read_sectors = NULL;
 
         /* Initialize devices. */
         for (dev_no = 0; dev_no < 2; dev_no++) {
@@ -202,44 +211,79 @@ disk_sector_t disk_size(struct disk *d) {
    room for DISK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
-void disk_read(struct disk *d, disk_sector_t sec_no, void *buffer) {
+void disk_read(struct disk *d, disk_sector_t sec_no, void *buffer) { disk_readv(d, sec_no, &buffer, 1); }
+
+/* Write sector SEC_NO to disk D from BUFFER, which must contain
+   DISK_SECTOR_SIZE bytes.  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void disk_write(struct disk *d, disk_sector_t sec_no, const void *buffer) { disk_writev(d, sec_no, &buffer, 1); }
+
+/* Reads the CNT sectors starting at SEC_NO from disk D, sector I
+   into SECTORS[I], with a single command.  CNT must be between 1
+   and DISK_MAX_SECTORS.  The buffers need not be adjacent, so a
+   caller can fill several scattered pages in one go.  The sectors
+   are taken off the disk by the interrupt handler as each becomes
+   ready, so the caller sleeps once for the whole command.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void disk_readv(struct disk *d, disk_sector_t sec_no, void *const sectors[], size_t cnt) {
     struct channel *c;
+    size_t i;
 
     ASSERT(d != NULL);
-    ASSERT(buffer != NULL);
+    ASSERT(sectors != NULL);
+    ASSERT(cnt > 0 && cnt <= DISK_MAX_SECTORS);
+
+    for (i = 0; i < cnt; i++)
+        ASSERT(sectors[i] != NULL);
 
     c = d->channel;
     lock_acquire(&c->lock);
-    select_sector(d, sec_no);
+    select_sectors(d, sec_no, cnt);
+    c->read_sectors = sectors;
+    c->read_size = cnt;
+    c->read_done = 0;
+    c->read_failed = false;
     issue_pio_command(c, CMD_READ_SECTOR_RETRY);
     sema_down(&c->completion_wait);
-    if (!wait_while_busy(d))
-        PANIC("%s: disk read failed, sector=%" PRDSNu, d->name, sec_no);
-    input_sector(c, buffer);
-    d->read_cnt++;
+    if (c->read_failed)
+        PANIC("%s: disk read failed, sector=%" PRDSNu, d->name, sec_no + (disk_sector_t)c->read_done);
+    d->read_cnt += cnt;
     lock_release(&c->lock);
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   DISK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
+/* Writes the CNT sectors starting at SEC_NO to disk D, sector I
+   from SECTORS[I], with a single command, and returns after the
+   disk has acknowledged the last of them.  CNT must be between 1
+   and DISK_MAX_SECTORS.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
-void disk_write(struct disk *d, disk_sector_t sec_no, const void *buffer) {
+void disk_writev(struct disk *d, disk_sector_t sec_no, const void *const sectors[], size_t cnt) {
     struct channel *c;
+    size_t i;
 
     ASSERT(d != NULL);
-    ASSERT(buffer != NULL);
+    ASSERT(sectors != NULL);
+    ASSERT(cnt > 0 && cnt <= DISK_MAX_SECTORS);
 
     c = d->channel;
     lock_acquire(&c->lock);
-    select_sector(d, sec_no);
+    select_sectors(d, sec_no, cnt);
     issue_pio_command(c, CMD_WRITE_SECTOR_RETRY);
-    if (!wait_while_busy(d))
-        PANIC("%s: disk write failed, sector=%" PRDSNu, d->name, sec_no);
-    output_sector(c, buffer);
+    for (i = 0; i < cnt; i++) {
+        /* The disk asks for the first sector at once and for each
+           later one with an interrupt. */
+        ASSERT(sectors[i] != NULL);
+        if (i > 0)
+            sema_down(&c->completion_wait);
+        if (!wait_while_busy(d))
+            PANIC("%s: disk write failed, sector=%" PRDSNu, d->name, sec_no + (disk_sector_t)i);
+        output_sector(c, sectors[i]);
+    }
     sema_down(&c->completion_wait);
-    d->write_cnt++;
+    d->write_cnt += cnt;
     lock_release(&c->lock);
 }
 
@@ -387,16 +431,17 @@ static void print_ata_string(char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
-static void select_sector(struct disk *d, disk_sector_t sec_no) {
+   writes SEC_NO and CNT to the disk's sector selection
+   registers.  (We use LBA mode.) */
+static void select_sectors(struct disk *d, disk_sector_t sec_no, size_t cnt) {
     struct channel *c = d->channel;
 
-    ASSERT(sec_no < d->capacity);
-    ASSERT(sec_no < (1UL << 28));
+    ASSERT(cnt > 0 && cnt <= DISK_MAX_SECTORS);
+    ASSERT(sec_no < d->capacity && cnt <= d->capacity - sec_no);
+    ASSERT(sec_no + cnt <= (1UL << 28));
 
     select_device_wait(d);
-    outb(reg_nsect(c), 1);
+    outb(reg_nsect(c), cnt); /* 256 is written as 0. */
     outb(reg_lbal(c), sec_no);
     outb(reg_lbam(c), sec_no >> 8);
     outb(reg_lbah(c), (sec_no >> 16));
@@ -490,7 +535,19 @@ static void interrupt_handler(struct intr_frame *f) {
     for (c = channels; c < channels + CHANNEL_CNT; c++)
         if (f->vec_no == c->irq) {
             if (c->expecting_interrupt) {
-                inb(reg_status(c));           /* Acknowledge interrupt. */
+                uint8_t status = inb(reg_status(c)); /* Acknowledge interrupt. */
+
+                /* The disk interrupts once per sector it has ready
+                   for a read in progress. */
+                if (c->read_sectors != NULL) {
+                    if ((status & (STA_BSY | STA_DRQ | STA_ERR)) == STA_DRQ)
+                        input_sector(c, c->read_sectors[c->read_done++]);
+                    else
+                        c->read_failed = true;
+                    if (!c->read_failed && c->read_done < c->read_size)
+                        return;
+                    c->read_sectors = NULL;
+                }
                 sema_up(&c->completion_wait); /* Wake up waiter. */
             } else
                 printf("%s: unexpected interrupt\n", c->name);
@@ -0,0 +1,341 @@
+/* buffer_cache.c: Buffer cache, a small cache of file system
+ * sectors in front of the disk.
+ *
+ * Every sector the inode layer reads or writes, inodes and data
+ * alike, goes through one of BCACHE_SIZE entries.  A read finds
+ * its sector here or reads it in, evicting the entry the clock
+ * hand reaches first that was not used since the hand last
+ * passed.  A write only changes the entry and marks it dirty: the
+ * sector reaches the disk when its entry is evicted, when the
+ * flusher thread wakes up every bcache_flush_interval ms, or when
+ * the file system is shut down, so that a sector written many
+ * times in a row is written to the disk once.  The flusher writes
+ * dirty sectors in order, each run of adjacent ones as a single
+ * command.
+ *
+ * Reads that continue where the previous read of a file ended ask
+ * for the file's next sector to be read ahead.  A reader thread
+ * reads it into the cache while the caller goes on with the
+ * sector it has, so that a file read from start to end mostly
+ * finds its sectors waiting.
+ *
+ * Entries are protected by bcache_lock.  Sectors are copied in
+ * and out with the lock held, which costs little for 512 bytes,
+ * but it is let go for disk I/O, during which the entry is marked
+ * busy: others that want the sector wait for it, and eviction
+ * passes it by. */
+
+#include "filesys/buffer_cache.h"
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include <debug.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Number of sectors cached, and of read-ahead requests queued. */
+#define BCACHE_SIZE 64
+#define AHEAD_SIZE 16
+
+/* A cached sector. */
+struct bcache_entry {
+    disk_sector_t sector; /* Sector held, if USED. */
+    bool used;            /* Holds a sector? */
+    bool dirty;           /* Changed since read or last written? */
+    bool accessed;        /* Used since the clock hand passed? */
+    bool io;              /* Being read or written; DATA not stable. */
+    uint8_t *data;        /* DISK_SECTOR_SIZE bytes. */
+};
+
+static struct bcache_entry entries[BCACHE_SIZE];
+static size_t clock_hand;
+static struct lock bcache_lock;
+static struct condition io_done; /* Signaled when an entry's I/O ends. */
+static bool bcache_ready;
+
+/* Read-ahead queue, a ring of sectors for the reader thread. */
+static disk_sector_t ahead[AHEAD_SIZE];
+static size_t ahead_head, ahead_cnt;
+static struct condition ahead_queued;
+
+unsigned bcache_flush_interval = 30000;
+
+/* Statistics. */
+static long long hit_cnt;        /* # of reads and writes that found their sector. */
+static long long miss_cnt;       /* # of reads and writes that did not. */
+static long long read_ahead_cnt; /* # of sectors read ahead. */
+static long long write_back_cnt; /* # of dirty sectors written back. */
+
+static struct bcache_entry *bcache_get(disk_sector_t, bool load, bool demand);
+static void reader(void *aux UNUSED);
+static void flusher(void *aux UNUSED);
+
+/* Sets up the cache, which must be after filesys_disk is, and
+ * starts its reader and flusher threads. */
+void bcache_init(void) {
+    uint8_t *data = palloc_get_multiple(PAL_ASSERT, BCACHE_SIZE * DISK_SECTOR_SIZE / PGSIZE);
+    size_t i;
+
+    for (i = 0; i < BCACHE_SIZE; i++)
+        entries[i].data = data + i * DISK_SECTOR_SIZE;
+    lock_init(&bcache_lock);
+    cond_init(&io_done);
+    cond_init(&ahead_queued);
+    bcache_ready = true;
+
+    thread_create("bc-reader", PRI_DEFAULT, reader, NULL);
+    if (bcache_flush_interval > 0)
+        thread_create("bc-flusher", PRI_DEFAULT, flusher, NULL);
+}
+
+/* Prints cache statistics. */
+void bcache_print_stats(void) {
+    long long total = hit_cnt + miss_cnt;
+
+    printf("Buffer cache: %lld hits, %lld misses (%lld%% hit rate), %lld sectors read ahead, %lld written back\n", hit_cnt, miss_cnt, total > 0 ? hit_cnt * 100 / total : 0, read_ahead_cnt,
+           write_back_cnt);
+}
+
+/* Reads sector SECTOR into BUFFER, which must have room for
+ * DISK_SECTOR_SIZE bytes. */
+void bcache_read(disk_sector_t sector, void *buffer) { bcache_read_at(sector, buffer, 0, DISK_SECTOR_SIZE); }
+
+/* Reads SIZE bytes of sector SECTOR, starting at OFS, into
+ * BUFFER. */
+void bcache_read_at(disk_sector_t sector, void *buffer, int ofs, int size) {
+    struct bcache_entry *e;
+
+    ASSERT(ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+    lock_acquire(&bcache_lock);
+    e = bcache_get(sector, true, true);
+    memcpy(buffer, e->data + ofs, size);
+    lock_release(&bcache_lock);
+}
+
+/* Copies sector SECTOR into BUFFER if it is cached, for callers
+ * that have just read it from the disk directly.  The cached copy
+ * is never older than the disk's, dirty or not: a write-back that
+ * cleared the entry's dirty flag may not have reached the disk
+ * before the caller read it.  If the entry is evicted while its
+ * write-back finishes, the sector is read in again, from a disk
+ * that now has it.  Returns true if it was copied. */
+bool bcache_peek(disk_sector_t sector, void *buffer) {
+    bool copied = false;
+    size_t i;
+
+    lock_acquire(&bcache_lock);
+    for (i = 0; i < BCACHE_SIZE; i++)
+        if (entries[i].used && entries[i].sector == sector) {
+            struct bcache_entry *e = bcache_get(sector, true, true);
+
+            memcpy(buffer, e->data, DISK_SECTOR_SIZE);
+            copied = true;
+            break;
+        }
+    lock_release(&bcache_lock);
+    return copied;
+}
+
+/* Writes BUFFER, DISK_SECTOR_SIZE bytes, to sector SECTOR. */
+void bcache_write(disk_sector_t sector, const void *buffer) { bcache_write_at(sector, buffer, 0, DISK_SECTOR_SIZE); }
+
+/* Writes SIZE bytes from BUFFER into sector SECTOR, starting at
+ * OFS.  The rest of the sector is read in first, unless the write
+ * covers all of it. */
+void bcache_write_at(disk_sector_t sector, const void *buffer, int ofs, int size) {
+    struct bcache_entry *e;
+
+    ASSERT(ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+    lock_acquire(&bcache_lock);
+    e = bcache_get(sector, size < DISK_SECTOR_SIZE, true);
+    memcpy(e->data + ofs, buffer, size);
+    e->dirty = true;
+    lock_release(&bcache_lock);
+}
+
+/* Asks for sector SECTOR to be read into the cache in the
+ * background, unless it is cached already.  The request is
+ * dropped if too many are queued. */
+void bcache_read_ahead(disk_sector_t sector) {
+    size_t i;
+
+    lock_acquire(&bcache_lock);
+    for (i = 0; i < BCACHE_SIZE; i++)
+        if (entries[i].used && entries[i].sector == sector)
+            break;
+    if (i == BCACHE_SIZE && ahead_cnt < AHEAD_SIZE) {
+        ahead[(ahead_head + ahead_cnt++) % AHEAD_SIZE] = sector;
+        cond_signal(&ahead_queued, &bcache_lock);
+    }
+    lock_release(&bcache_lock);
+}
+
+/* Orders entries A and B by sector, for qsort(). */
+static int compare_sectors(const void *a_, const void *b_) {
+    const struct bcache_entry *a = *(struct bcache_entry *const *)a_;
+    const struct bcache_entry *b = *(struct bcache_entry *const *)b_;
+
+    return a->sector < b->sector ? -1 : a->sector > b->sector;
+}
+
+/* Writes every dirty sector to the disk, in order of sector
+ * number, one command per run of adjacent sectors. */
+void bcache_flush(void) {
+    struct bcache_entry *dirty[BCACHE_SIZE];
+    const void *bufs[BCACHE_SIZE];
+    size_t cnt = 0, i, run;
+
+    if (!bcache_ready)
+        return;
+
+    lock_acquire(&bcache_lock);
+    for (i = 0; i < BCACHE_SIZE; i++) {
+        struct bcache_entry *e = &entries[i];
+
+        if (e->used && e->dirty && !e->io) {
+            e->io = true;
+            e->dirty = false;
+            dirty[cnt++] = e;
+        }
+    }
+    lock_release(&bcache_lock);
+
+    qsort(dirty, cnt, sizeof *dirty, compare_sectors);
+    for (i = 0; i < cnt; i += run) {
+        for (run = 0; i + run < cnt && dirty[i + run]->sector == dirty[i]->sector + run; run++)
+            bufs[run] = dirty[i + run]->data;
+        disk_writev(filesys_disk, dirty[i]->sector, bufs, run);
+    }
+
+    lock_acquire(&bcache_lock);
+    for (i = 0; i < cnt; i++)
+        dirty[i]->io = false;
+    write_back_cnt += cnt;
+    cond_broadcast(&io_done, &bcache_lock);
+    lock_release(&bcache_lock);
+}
+
+/* Returns the entry the clock hand picks for a new sector: a free
+ * one if there is one, otherwise the first one not used since the
+ * hand last passed.  Returns a null pointer if every entry is
+ * busy. */
+static struct bcache_entry *bcache_victim(void) {
+    size_t i;
+
+    for (i = 0; i < BCACHE_SIZE; i++)
+        if (!entries[i].used)
+            return &entries[i];
+
+    for (i = 0; i < 2 * BCACHE_SIZE; i++) {
+        struct bcache_entry *e = &entries[clock_hand];
+
+        clock_hand = (clock_hand + 1) % BCACHE_SIZE;
+        if (e->io)
+            continue;
+        if (e->accessed)
+            e->accessed = false;
+        else
+            return e;
+    }
+    return NULL;
+}
+
+/* Returns the entry holding sector SECTOR, caching it first if it
+ * is not.  If LOAD is false, a sector that has to be cached is
+ * not read, because the caller will overwrite all of it.  DEMAND
+ * is false for read-ahead, which is not counted as a hit or a
+ * miss.  The lock must be held; it is let go while waiting for the
+ * disk. */
+static struct bcache_entry *bcache_get(disk_sector_t sector, bool load, bool demand) {
+    for (;;) {
+        struct bcache_entry *e = NULL;
+        size_t i;
+
+        for (i = 0; i < BCACHE_SIZE; i++)
+            if (entries[i].used && entries[i].sector == sector) {
+                e = &entries[i];
+                break;
+            }
+
+        if (e != NULL) {
+            if (e->io) {
+                cond_wait(&io_done, &bcache_lock);
+                continue;
+            }
+            if (demand)
+                hit_cnt++;
+            e->accessed = true;
+            return e;
+        }
+
+        e = bcache_victim();
+        if (e == NULL) {
+            cond_wait(&io_done, &bcache_lock);
+            continue;
+        }
+
+        if (e->used && e->dirty) {
+            /* Write the victim back, then look again: another
+             * thread may have cached SECTOR meanwhile. */
+            e->io = true;
+            e->dirty = false;
+            lock_release(&bcache_lock);
+            disk_write(filesys_disk, e->sector, e->data);
+            lock_acquire(&bcache_lock);
+            e->io = false;
+            write_back_cnt++;
+            cond_broadcast(&io_done, &bcache_lock);
+            continue;
+        }
+
+        if (demand)
+            miss_cnt++;
+        else
+            read_ahead_cnt++;
+        e->sector = sector;
+        e->used = true;
+        e->dirty = false;
+        e->accessed = true;
+        if (load) {
+            e->io = true;
+            lock_release(&bcache_lock);
+            disk_read(filesys_disk, sector, e->data);
+            lock_acquire(&bcache_lock);
+            e->io = false;
+            cond_broadcast(&io_done, &bcache_lock);
+        }
+        return e;
+    }
+}
+
+/* Read-ahead thread.  Reads the queued sectors into the cache,
+ * one at a time, in the order they were asked for. */
+static void reader(void *aux UNUSED) {
+    lock_acquire(&bcache_lock);
+    for (;;) {
+        disk_sector_t sector;
+
+        while (ahead_cnt == 0)
+            cond_wait(&ahead_queued, &bcache_lock);
+        sector = ahead[ahead_head];
+        ahead_head = (ahead_head + 1) % AHEAD_SIZE;
+        ahead_cnt--;
+        bcache_get(sector, true, false);
+    }
+}
+
+/* Write-behind thread.  Every bcache_flush_interval milliseconds,
+ * writes the dirty sectors back, so that fewer writes are lost if
+ * the machine stops. */
+static void flusher(void *aux UNUSED) {
+    for (;;) {
+        timer_msleep(bcache_flush_interval);
+        bcache_flush();
+    }
+}
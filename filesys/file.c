@@ -2,6 +2,9 @@
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 #include <debug.h>
+#ifdef VM
+#include "vm/pcache.h"
+#endif
 
 /* An open file. */
 struct file {
@@ -10,6 +13,27 @@ struct file {
     bool deny_write;     /* Has file_deny_write() been called? */
 };
 
+/* Reads SIZE bytes of INODE at OFFSET into BUFFER.  With virtual
+ * memory, reads go through the page cache, which file mappings
+ * share; FILL says whether pages it lacks are read into it. */
+static off_t read_at(struct inode *inode, void *buffer, off_t size, off_t offset, bool fill UNUSED) {
+#ifdef VM
+    return pcache_read(inode, buffer, size, offset, fill);
+#else
+    return inode_read_at(inode, buffer, size, offset);
+#endif
+}
+
+/* Writes SIZE bytes from BUFFER into INODE at OFFSET, and into the
+ * page cache, if there is one. */
+static off_t write_at(struct inode *inode, const void *buffer, off_t size, off_t offset) {
+#ifdef VM
+    return pcache_write(inode, buffer, size, offset);
+#else
+    return inode_write_at(inode, buffer, size, offset);
+#endif
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
  * and returns the new file.  Returns a null pointer if an
  * allocation fails or if INODE is null. */
@@ -61,7 +85,7 @@ struct inode *file_get_inode(struct file *file) { return file->inode; }
  * which may be less than SIZE if end of file is reached.
  * Advances FILE's position by the number of bytes read. */
 off_t file_read(struct file *file, void *buffer, off_t size) {
-    off_t bytes_read = inode_read_at(file->inode, buffer, size, file->pos);
+    off_t bytes_read = read_at(file->inode, buffer, size, file->pos, true);
     file->pos += bytes_read;
     return bytes_read;
 }
@@ -71,17 +95,23 @@ off_t file_read(struct file *file, void *buffer, off_t size) {
  * Returns the number of bytes actually read,
  * which may be less than SIZE if end of file is reached.
  * The file's current position is unaffected. */
-off_t file_read_at(struct file *file, void *buffer, off_t size, off_t file_ofs) { return inode_read_at(file->inode, buffer, size, file_ofs); }
+off_t file_read_at(struct file *file, void *buffer, off_t size, off_t file_ofs) { return read_at(file->inode, buffer, size, file_ofs, false); }
+
+/* Reads SIZE bytes from FILE into the pages PAGES[0], PAGES[1],
+ * and so on, starting at offset FILE_OFS in the file, which must
+ * be sector-aligned.  Returns the number of bytes actually read,
+ * which may be less than SIZE if end of file is reached.  The
+ * file's current position is unaffected. */
+off_t file_read_pages_at(struct file *file, void *const pages[], off_t size, off_t file_ofs) { return inode_read_pages(file->inode, pages, size, file_ofs); }
 
 /* Writes SIZE bytes from BUFFER into FILE,
  * starting at the file's current position.
  * Returns the number of bytes actually written,
- * which may be less than SIZE if end of file is reached.
- * (Normally we'd grow the file in that case, but file growth is
- * not yet implemented.)
+ * which may be less than SIZE if the disk fills up.
+ * Writing past end of file extends the file.
  * Advances FILE's position by the number of bytes read. */
 off_t file_write(struct file *file, const void *buffer, off_t size) {
-    off_t bytes_written = inode_write_at(file->inode, buffer, size, file->pos);
+    off_t bytes_written = write_at(file->inode, buffer, size, file->pos);
     file->pos += bytes_written;
     return bytes_written;
 }
@@ -89,11 +119,10 @@ off_t file_write(struct file *file, const void *buffer, off_t size) {
 /* Writes SIZE bytes from BUFFER into FILE,
  * starting at offset FILE_OFS in the file.
  * Returns the number of bytes actually written,
- * which may be less than SIZE if end of file is reached.
- * (Normally we'd grow the file in that case, but file growth is
- * not yet implemented.)
+ * which may be less than SIZE if the disk fills up.
+ * Writing past end of file extends the file.
  * The file's current position is unaffected. */
-off_t file_write_at(struct file *file, const void *buffer, off_t size, off_t file_ofs) { return inode_write_at(file->inode, buffer, size, file_ofs); }
+off_t file_write_at(struct file *file, const void *buffer, off_t size, off_t file_ofs) { return write_at(file->inode, buffer, size, file_ofs); }
 
 /* Prevents write operations on FILE's underlying inode
  * until file_allow_write() is called or FILE is closed. */
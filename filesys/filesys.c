@@ -1,5 +1,6 @@
 #include "filesys/filesys.h"
 #include "devices/disk.h"
+#include "filesys/buffer_cache.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
@@ -20,6 +21,7 @@ void filesys_init(bool format) {
     if (filesys_disk == NULL)
         PANIC("hd0:1 (hdb) not present, file system initialization failed");
 
+    bcache_init();
     inode_init();
 
 #ifdef EFILESYS
@@ -49,6 +51,7 @@ void filesys_done(void) {
 #else
     free_map_close();
 #endif
+    bcache_flush();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -1,22 +1,41 @@
 #include "filesys/inode.h"
+#include "filesys/buffer_cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 #include <debug.h>
 #include <list.h>
 #include <round.h>
 #include <string.h>
+#ifdef VM
+#include "vm/pcache.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Sectors in a page, and most read by inode_read_pages() at once. */
+#define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
+#define READ_PAGES_BATCH 64
+
+/* Block index.  The first DIRECT_CNT sectors of a file are listed
+ * in its inode, the next INDEX_CNT in an indirect block, and the
+ * next INDEX_CNT * INDEX_CNT in the indirect blocks listed by a
+ * doubly-indirect block.  A sector number of 0, which is the free
+ * map's inode and never holds data, means none is allocated. */
+#define DIRECT_CNT 124
+#define INDEX_CNT (DISK_SECTOR_SIZE / sizeof(disk_sector_t))
+
 /* On-disk inode.
  * Must be exactly DISK_SECTOR_SIZE bytes long. */
 struct inode_disk {
-    disk_sector_t start;  /* First data sector. */
-    off_t length;         /* File size in bytes. */
-    unsigned magic;       /* Magic number. */
-    uint32_t unused[125]; /* Not used. */
+    off_t length;                     /* File size in bytes. */
+    unsigned magic;                   /* Magic number. */
+    disk_sector_t direct[DIRECT_CNT]; /* First data sectors. */
+    disk_sector_t indirect;           /* Indirect block. */
+    disk_sector_t doubly_indirect;    /* Doubly-indirect block. */
 };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -30,9 +49,36 @@ struct inode {
     int open_cnt;           /* Number of openers. */
     bool removed;           /* True if deleted, false otherwise. */
     int deny_write_cnt;     /* 0: writes ok, >0: deny writes. */
+    off_t read_end;         /* Where the last read ended. */
     struct inode_disk data; /* Inode content. */
+    struct lock grow_lock;  /* Held to allocate sectors. */
+
+    /* Copies of the index blocks, kept while the inode is open so
+     * that finding a sector reads at most one block, and none for
+     * the first DIRECT_CNT.  Null until the block is allocated. */
+    disk_sector_t *indirect; /* Indirect block. */
+    disk_sector_t *doubly;   /* Doubly-indirect block. */
 };
 
+/* Returns the sector holding sector IDX of INODE's data, or 0 if
+ * none is allocated.  Sectors are only ever added to the index,
+ * and are in it before the inode's length covers them, so readers
+ * need no lock. */
+static disk_sector_t index_get(const struct inode *inode, size_t idx) {
+    disk_sector_t sector;
+
+    if (idx < DIRECT_CNT)
+        return inode->data.direct[idx];
+    idx -= DIRECT_CNT;
+    if (idx < INDEX_CNT)
+        return inode->indirect != NULL ? inode->indirect[idx] : 0;
+    idx -= INDEX_CNT;
+    if (idx >= INDEX_CNT * INDEX_CNT || inode->doubly == NULL || inode->doubly[idx / INDEX_CNT] == 0)
+        return 0;
+    bcache_read_at(inode->doubly[idx / INDEX_CNT], &sector, idx % INDEX_CNT * sizeof sector, sizeof sector);
+    return sector;
+}
+
 /* Returns the disk sector that contains byte offset POS within
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
@@ -40,11 +86,150 @@ struct inode {
 static disk_sector_t byte_to_sector(const struct inode *inode, off_t pos) {
     ASSERT(inode != NULL);
     if (pos < inode->data.length)
-        return inode->data.start + pos / DISK_SECTOR_SIZE;
+        return index_get(inode, pos / DISK_SECTOR_SIZE);
     else
         return -1;
 }
 
+/* Stores a newly allocated sector, filled with zeros, in *SECTORP,
+ * unless it holds one already.  Returns false if the disk is
+ * full. */
+static bool allocate_sector(disk_sector_t *sectorp) {
+    static char zeros[DISK_SECTOR_SIZE];
+    disk_sector_t sector;
+
+    if (*sectorp != 0)
+        return true;
+    if (!free_map_allocate(1, &sector))
+        return false;
+    bcache_write(sector, zeros);
+    *sectorp = sector;
+    return true;
+}
+
+/* Reads index block SECTOR into a new copy and stores it in
+ * *BLOCKP.  Returns false if memory is short. */
+static bool load_index(disk_sector_t sector, disk_sector_t **blockp) {
+    disk_sector_t *block = malloc(DISK_SECTOR_SIZE);
+
+    if (block == NULL)
+        return false;
+    bcache_read(sector, block);
+
+    /* Readers may look at *BLOCKP at any time. */
+    barrier();
+    *blockp = block;
+    return true;
+}
+
+/* Makes sure the index block at *SECTORP exists and its copy is
+ * in *BLOCKP, allocating the block if need be.  Returns false if
+ * the disk or memory is short. */
+static bool index_block(disk_sector_t *sectorp, disk_sector_t **blockp) {
+    if (*blockp != NULL)
+        return true;
+    return allocate_sector(sectorp) && load_index(*sectorp, blockp);
+}
+
+/* Allocates entry IDX of index block SECTOR, whose copy is BLOCK,
+ * if it is not allocated yet.  Returns false if the disk is
+ * full. */
+static bool index_set(disk_sector_t sector, disk_sector_t *block, size_t idx) {
+    if (block[idx] != 0)
+        return true;
+    if (!allocate_sector(&block[idx]))
+        return false;
+    bcache_write_at(sector, &block[idx], idx * sizeof *block, sizeof *block);
+    return true;
+}
+
+/* Allocates sector IDX of INODE's data, and the index blocks that
+ * lead to it, where they are not allocated yet.  Returns false if
+ * the disk or memory is short or IDX is past the largest file. */
+static bool index_allocate(struct inode *inode, size_t idx) {
+    struct inode_disk *data = &inode->data;
+    disk_sector_t sector, entry = 0;
+    size_t ofs;
+
+    if (idx < DIRECT_CNT)
+        return allocate_sector(&data->direct[idx]);
+    idx -= DIRECT_CNT;
+    if (idx < INDEX_CNT)
+        return index_block(&data->indirect, &inode->indirect) && index_set(data->indirect, inode->indirect, idx);
+    idx -= INDEX_CNT;
+    if (idx >= INDEX_CNT * INDEX_CNT)
+        return false;
+    if (!index_block(&data->doubly_indirect, &inode->doubly) || !index_set(data->doubly_indirect, inode->doubly, idx / INDEX_CNT))
+        return false;
+
+    /* The second-level blocks are not copied, only cached. */
+    sector = inode->doubly[idx / INDEX_CNT];
+    ofs = idx % INDEX_CNT * sizeof entry;
+    bcache_read_at(sector, &entry, ofs, sizeof entry);
+    if (entry != 0)
+        return true;
+    if (!allocate_sector(&entry))
+        return false;
+    bcache_write_at(sector, &entry, ofs, sizeof entry);
+    return true;
+}
+
+/* Allocates the sectors INODE needs to hold LENGTH bytes, and
+ * writes its inode if any were added.  Returns false, having
+ * allocated some of them or none, if the disk or memory is
+ * short. */
+static bool inode_grow(struct inode *inode, off_t length) {
+    size_t idx, cnt = bytes_to_sectors(length);
+    bool success = true;
+
+    lock_acquire(&inode->grow_lock);
+    for (idx = bytes_to_sectors(inode->data.length); idx < cnt; idx++)
+        if (!index_allocate(inode, idx)) {
+            success = false;
+            break;
+        }
+    if (idx > bytes_to_sectors(inode->data.length))
+        bcache_write(inode->sector, &inode->data);
+    lock_release(&inode->grow_lock);
+    return success;
+}
+
+/* Releases SECTOR, which is a data sector if LEVEL is 0 and an
+ * index block LEVEL levels above the data otherwise, with every
+ * sector it leads to.  Does nothing if SECTOR is 0. */
+static void release_index(disk_sector_t sector, int level) {
+    if (sector == 0)
+        return;
+    if (level > 0) {
+        disk_sector_t *block = malloc(DISK_SECTOR_SIZE);
+        size_t i;
+
+        if (block != NULL) {
+            bcache_read(sector, block);
+            for (i = 0; i < INDEX_CNT; i++)
+                release_index(block[i], level - 1);
+            free(block);
+        }
+    }
+    free_map_release(sector, 1);
+}
+
+/* Releases the sectors of the file DATA describes. */
+static void release_sectors(const struct inode_disk *data) {
+    size_t i;
+
+    for (i = 0; i < DIRECT_CNT; i++)
+        release_index(data->direct[i], 0);
+    release_index(data->indirect, 1);
+    release_index(data->doubly_indirect, 2);
+}
+
+/* Frees INODE's copies of its index blocks. */
+static void free_index(struct inode *inode) {
+    free(inode->indirect);
+    free(inode->doubly);
+}
+
 /* List of open inodes, so that opening a single inode twice
  * returns the same `struct inode'. */
 static struct list open_inodes;
@@ -54,36 +239,35 @@ void inode_init(void) { list_init(&open_inodes); }
 
 /* Initializes an inode with LENGTH bytes of data and
  * writes the new inode to sector SECTOR on the file system
- * disk.
+ * disk.  The data sectors are allocated one at a time, wherever
+ * they are free, and zeroed.
  * Returns true if successful.
  * Returns false if memory or disk allocation fails. */
 bool inode_create(disk_sector_t sector, off_t length) {
-    struct inode_disk *disk_inode = NULL;
+    struct inode *inode = NULL;
     bool success = false;
 
     ASSERT(length >= 0);
 
     /* If this assertion fails, the inode structure is not exactly
      * one sector in size, and you should fix that. */
-    ASSERT(sizeof *disk_inode == DISK_SECTOR_SIZE);
-
-    disk_inode = calloc(1, sizeof *disk_inode);
-    if (disk_inode != NULL) {
-        size_t sectors = bytes_to_sectors(length);
-        disk_inode->length = length;
-        disk_inode->magic = INODE_MAGIC;
-        if (free_map_allocate(sectors, &disk_inode->start)) {
-            disk_write(filesys_disk, sector, disk_inode);
-            if (sectors > 0) {
-                static char zeros[DISK_SECTOR_SIZE];
-                size_t i;
-
-                for (i = 0; i < sectors; i++)
-                    disk_write(filesys_disk, disk_inode->start + i, zeros);
-            }
+    ASSERT(sizeof inode->data == DISK_SECTOR_SIZE);
+
+    /* The new inode is not open, but is built in a `struct inode'
+     * so that it can grow like one. */
+    inode = calloc(1, sizeof *inode);
+    if (inode != NULL) {
+        inode->sector = sector;
+        inode->data.magic = INODE_MAGIC;
+        lock_init(&inode->grow_lock);
+        if (inode_grow(inode, length)) {
+            inode->data.length = length;
+            bcache_write(sector, &inode->data);
             success = true;
-        }
-        free(disk_inode);
+        } else
+            release_sectors(&inode->data);
+        free_index(inode);
+        free(inode);
     }
     return success;
 }
@@ -115,7 +299,17 @@ struct inode *inode_open(disk_sector_t sector) {
     inode->open_cnt = 1;
     inode->deny_write_cnt = 0;
     inode->removed = false;
-    disk_read(filesys_disk, inode->sector, &inode->data);
+    inode->read_end = 0;
+    lock_init(&inode->grow_lock);
+    inode->indirect = inode->doubly = NULL;
+    bcache_read(inode->sector, &inode->data);
+    if ((inode->data.indirect != 0 && !load_index(inode->data.indirect, &inode->indirect)) ||
+        (inode->data.doubly_indirect != 0 && !load_index(inode->data.doubly_indirect, &inode->doubly))) {
+        list_remove(&inode->elem);
+        free_index(inode);
+        free(inode);
+        return NULL;
+    }
     return inode;
 }
 
@@ -144,10 +338,14 @@ void inode_close(struct inode *inode) {
 
         /* Deallocate blocks if removed. */
         if (inode->removed) {
+#ifdef VM
+            pcache_drop(inode);
+#endif
             free_map_release(inode->sector, 1);
-            free_map_release(inode->data.start, bytes_to_sectors(inode->data.length));
+            release_sectors(&inode->data);
         }
 
+        free_index(inode);
         free(inode);
     }
 }
@@ -161,11 +359,14 @@ void inode_remove(struct inode *inode) {
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
  * Returns the number of bytes actually read, which may be less
- * than SIZE if an error occurs or end of file is reached. */
+ * than SIZE if an error occurs or end of file is reached.
+ * A read that starts where the last one ended has the sector after
+ * it read ahead. */
 off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset) {
     uint8_t *buffer = buffer_;
     off_t bytes_read = 0;
-    uint8_t *bounce = NULL;
+    bool sequential = offset == inode->read_end;
+    off_t next;
 
     while (size > 0) {
         /* Disk sector to read, starting byte offset within sector. */
@@ -182,87 +383,115 @@ off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset
         if (chunk_size <= 0)
             break;
 
-        if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-            /* Read full sector directly into caller's buffer. */
-            disk_read(filesys_disk, sector_idx, buffer + bytes_read);
-        } else {
-            /* Read sector into bounce buffer, then partially copy
-             * into caller's buffer. */
-            if (bounce == NULL) {
-                bounce = malloc(DISK_SECTOR_SIZE);
-                if (bounce == NULL)
-                    break;
-            }
-            disk_read(filesys_disk, sector_idx, bounce);
-            memcpy(buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+        bcache_read_at(sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
 
         /* Advance. */
         size -= chunk_size;
         offset += chunk_size;
         bytes_read += chunk_size;
     }
-    free(bounce);
+
+    /* The sector holding the next byte is cached already unless the
+     * read ended on a sector boundary. */
+    next = ROUND_UP(offset, DISK_SECTOR_SIZE);
+    if (sequential && bytes_read > 0 && next < inode_length(inode))
+        bcache_read_ahead(byte_to_sector(inode, next));
+    inode->read_end = offset;
 
     return bytes_read;
 }
 
+/* Reads SIZE bytes from INODE, starting at OFFSET, which must be
+ * sector-aligned, into the pages PAGES[0], PAGES[1], and so on,
+ * one after another.  Each run of contiguous sectors goes to the
+ * disk as one command of up to READ_PAGES_BATCH sectors, without
+ * passing through the buffer cache, and then the sectors the cache
+ * holds newer copies of are copied over them.  Only a partial last
+ * sector goes through the cache.  Returns the number of bytes
+ * actually read, which is less than SIZE if end of file is
+ * reached. */
+off_t inode_read_pages(struct inode *inode, void *const pages[], off_t size, off_t offset) {
+    void *sectors[READ_PAGES_BATCH];
+    off_t length = inode_length(inode);
+    size_t full, i = 0, j;
+
+    ASSERT(offset % DISK_SECTOR_SIZE == 0);
+
+    if (offset >= length || size <= 0)
+        return 0;
+    if (size > length - offset)
+        size = length - offset;
+
+    full = size / DISK_SECTOR_SIZE;
+    while (i < full) {
+        disk_sector_t first = byte_to_sector(inode, offset + i * DISK_SECTOR_SIZE);
+        size_t cnt = 0;
+
+        while (i + cnt < full && cnt < READ_PAGES_BATCH && byte_to_sector(inode, offset + (i + cnt) * DISK_SECTOR_SIZE) == first + cnt) {
+            sectors[cnt] = (uint8_t *)pages[(i + cnt) / SECTORS_PER_PAGE] + (i + cnt) % SECTORS_PER_PAGE * DISK_SECTOR_SIZE;
+            cnt++;
+        }
+        disk_readv(filesys_disk, first, sectors, cnt);
+        for (j = 0; j < cnt; j++)
+            bcache_peek(first + j, sectors[j]);
+        i += cnt;
+    }
+
+    if (size % DISK_SECTOR_SIZE != 0)
+        bcache_read_at(byte_to_sector(inode, offset + full * DISK_SECTOR_SIZE), (uint8_t *)pages[full / SECTORS_PER_PAGE] + full % SECTORS_PER_PAGE * DISK_SECTOR_SIZE, 0,
+                       size % DISK_SECTOR_SIZE);
+    return size;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * less than SIZE if the disk fills up or an error occurs.
+ * A write past end of file extends the inode, and the bytes
+ * between the old end and OFFSET read as zeros.  The sectors
+ * written reach the disk later, when the buffer cache writes them
+ * back. */
 off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size, off_t offset) {
     const uint8_t *buffer = buffer_;
     off_t bytes_written = 0;
-    uint8_t *bounce = NULL;
 
     if (inode->deny_write_cnt)
         return 0;
 
+    /* If not every sector can be allocated, write as far as the
+     * ones that were reach. */
+    if (size > 0 && offset + size > inode_length(inode))
+        inode_grow(inode, offset + size);
+
     while (size > 0) {
         /* Sector to write, starting byte offset within sector. */
-        disk_sector_t sector_idx = byte_to_sector(inode, offset);
+        disk_sector_t sector_idx = index_get(inode, offset / DISK_SECTOR_SIZE);
         int sector_ofs = offset % DISK_SECTOR_SIZE;
 
-        /* Bytes left in inode, bytes left in sector, lesser of the two. */
-        off_t inode_left = inode_length(inode) - offset;
-        int sector_left = DISK_SECTOR_SIZE - sector_ofs;
-        int min_left = inode_left < sector_left ? inode_left : sector_left;
-
         /* Number of bytes to actually write into this sector. */
-        int chunk_size = size < min_left ? size : min_left;
-        if (chunk_size <= 0)
+        int sector_left = DISK_SECTOR_SIZE - sector_ofs;
+        int chunk_size = size < sector_left ? size : sector_left;
+        if (sector_idx == 0)
             break;
 
-        if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-            /* Write full sector directly to disk. */
-            disk_write(filesys_disk, sector_idx, buffer + bytes_written);
-        } else {
-            /* We need a bounce buffer. */
-            if (bounce == NULL) {
-                bounce = malloc(DISK_SECTOR_SIZE);
-                if (bounce == NULL)
-                    break;
-            }
-
-            /* If the sector contains data before or after the chunk
-               we're writing, then we need to read in the sector
-               first.  Otherwise we start with a sector of all zeros. */
-            if (sector_ofs > 0 || chunk_size < sector_left)
-                disk_read(filesys_disk, sector_idx, bounce);
-            else
-                memset(bounce, 0, DISK_SECTOR_SIZE);
-            memcpy(bounce + sector_ofs, buffer + bytes_written, chunk_size);
-            disk_write(filesys_disk, sector_idx, bounce);
-        }
+        /* The cache reads the rest of a partly written sector in
+         * first. */
+        bcache_write_at(sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
 
         /* Advance. */
         size -= chunk_size;
         offset += chunk_size;
         bytes_written += chunk_size;
     }
-    free(bounce);
+
+    /* Readers see the new length only once the data is there. */
+    if (bytes_written > 0 && offset > inode_length(inode)) {
+        lock_acquire(&inode->grow_lock);
+        if (offset > inode->data.length) {
+            inode->data.length = offset;
+            bcache_write(inode->sector, &inode->data);
+        }
+        lock_release(&inode->grow_lock);
+    }
 
     return bytes_written;
 }
@@ -2,11 +2,15 @@
 #define DEVICES_DISK_H
 
 #include <inttypes.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* Size of a disk sector in bytes. */
 #define DISK_SECTOR_SIZE 512
 
+/* Most sectors one command can transfer. */
+#define DISK_MAX_SECTORS 256
+
 /* Index of a disk sector within a disk.
  * Good enough for disks up to 2 TB. */
 typedef uint32_t disk_sector_t;
@@ -22,6 +26,8 @@ struct disk *disk_get(int chan_no, int dev_no);
 disk_sector_t disk_size(struct disk *);
 void disk_read(struct disk *, disk_sector_t, void *);
 void disk_write(struct disk *, disk_sector_t, const void *);
+void disk_readv(struct disk *, disk_sector_t, void *const[], size_t cnt);
+void disk_writev(struct disk *, disk_sector_t, const void *const[], size_t cnt);
 
 void register_disk_inspect_intr();
 #endif /* devices/disk.h */
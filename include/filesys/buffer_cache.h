@@ -0,0 +1,21 @@
+#ifndef FILESYS_BUFFER_CACHE_H
+#define FILESYS_BUFFER_CACHE_H
+
+#include "devices/disk.h"
+#include <stdbool.h>
+
+void bcache_init(void);
+void bcache_read(disk_sector_t, void *);
+void bcache_read_at(disk_sector_t, void *, int ofs, int size);
+bool bcache_peek(disk_sector_t, void *);
+void bcache_write(disk_sector_t, const void *);
+void bcache_write_at(disk_sector_t, const void *, int ofs, int size);
+void bcache_read_ahead(disk_sector_t);
+void bcache_flush(void);
+void bcache_print_stats(void);
+
+/* -bc-interval=MS: how often dirty sectors are written back (0 turns
+ * the flusher off). */
+extern unsigned bcache_flush_interval;
+
+#endif /* filesys/buffer_cache.h */
@@ -15,6 +15,7 @@ disk_sector_t inode_get_inumber(const struct inode *);
 void inode_close(struct inode *);
 void inode_remove(struct inode *);
 off_t inode_read_at(struct inode *, void *, off_t size, off_t offset);
+off_t inode_read_pages(struct inode *, void *const pages[], off_t size, off_t offset);
 off_t inode_write_at(struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write(struct inode *);
 void inode_allow_write(struct inode *);
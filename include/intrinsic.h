@@ -8,6 +8,40 @@
    of the Page Directory". */
 __attribute__((always_inline)) static __inline void lcr3(uint64_t val) { __asm __volatile("movq %0, %%cr3" : : "r"(val)); }
 
+/* Read and write control register 4, which holds the paging feature
+   enables such as CR4.PCIDE.  See [IA32-v3a] 2.5 "Control Registers". */
+__attribute__((always_inline)) static __inline uint64_t rcr4(void) {
+    uint64_t val;
+    __asm __volatile("movq %%cr4,%0" : "=r"(val));
+    return val;
+}
+
+__attribute__((always_inline)) static __inline void lcr4(uint64_t val) { __asm __volatile("movq %0, %%cr4" : : "r"(val) : "memory"); }
+
+/* Read and write control register 0, which holds CR0.WP. */
+__attribute__((always_inline)) static __inline uint64_t rcr0(void) {
+    uint64_t val;
+    __asm __volatile("movq %%cr0,%0" : "=r"(val));
+    return val;
+}
+
+__attribute__((always_inline)) static __inline void lcr0(uint64_t val) { __asm __volatile("movq %0, %%cr0" : : "r"(val) : "memory"); }
+
+/* Executes CPUID for LEAF (sub-leaf 0) and stores the resulting
+   registers into the non-null output pointers. */
+__attribute__((always_inline)) static __inline void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+    uint32_t a, b, c, d;
+    __asm __volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(leaf), "c"(0));
+    if (eax)
+        *eax = a;
+    if (ebx)
+        *ebx = b;
+    if (ecx)
+        *ecx = c;
+    if (edx)
+        *edx = d;
+}
+
 __attribute__((always_inline)) static __inline void lgdt(const struct desc_ptr *dtr) { __asm __volatile("lgdt %0" : : "m"(*dtr)); }
 
 __attribute__((always_inline)) static __inline void lldt(uint16_t sel) { __asm __volatile("lldt %0" : : "r"(sel)); }
@@ -96,4 +130,11 @@ __attribute__((always_inline)) static __inline void write_msr(uint32_t ecx, uint
     __asm __volatile("wrmsr" ::"c"(ecx), "d"(edx), "a"(eax));
 }
 
+/* Reads the time-stamp counter. */
+__attribute__((always_inline)) static __inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm __volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
 #endif /* intrinsic.h */
@@ -0,0 +1,62 @@
+#ifndef __LIB_KERNEL_ITREE_H
+#define __LIB_KERNEL_ITREE_H
+
+/* Interval tree.
+ *
+ * A balanced (AVL) binary search tree of half-open intervals
+ * [start, end), ordered by start and augmented with the greatest
+ * end in each subtree.  Finding the intervals that overlap a
+ * query range takes O(log n + k) for k results; intervals may
+ * overlap each other.
+ *
+ * Like lists and hash tables, the tree does no dynamic
+ * allocation.  Each structure that can be in an interval tree
+ * embeds a struct itree_elem, sets its START and END, and then
+ * inserts it.  The bounds of an element must not change while it
+ * is in a tree; remove it, change them, and insert it again.
+ * itree_entry() converts a struct itree_elem back to the
+ * structure that contains it, just like list_entry(). */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Interval tree element. */
+struct itree_elem {
+    uint64_t start;           /* First value in the interval. */
+    uint64_t end;             /* One past the last value. */
+    uint64_t max_end;         /* Greatest END in this subtree. */
+    struct itree_elem *parent;
+    struct itree_elem *left;  /* Subtree with smaller starts. */
+    struct itree_elem *right; /* Subtree with larger or equal starts. */
+    int height;               /* Height of this subtree. */
+};
+
+/* Interval tree. */
+struct itree {
+    struct itree_elem *root;
+    size_t elem_cnt;
+};
+
+/* Converts pointer to interval tree element ITREE_ELEM into a
+ * pointer to the structure that ITREE_ELEM is embedded inside. */
+#define itree_entry(ITREE_ELEM, STRUCT, MEMBER) ((STRUCT *)((uint8_t *)(ITREE_ELEM) - offsetof(STRUCT, MEMBER)))
+
+void itree_init(struct itree *);
+
+void itree_insert(struct itree *, struct itree_elem *);
+void itree_remove(struct itree *, struct itree_elem *);
+
+/* Range queries. */
+struct itree_elem *itree_find(struct itree *, uint64_t point);
+struct itree_elem *itree_first_overlap(struct itree *, uint64_t start, uint64_t end);
+struct itree_elem *itree_next_overlap(struct itree_elem *, uint64_t start, uint64_t end);
+
+/* In-order traversal. */
+struct itree_elem *itree_first(struct itree *);
+struct itree_elem *itree_next(struct itree_elem *);
+
+size_t itree_size(struct itree *);
+bool itree_empty(struct itree *);
+
+#endif /* lib/kernel/itree.h */
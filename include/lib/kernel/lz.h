@@ -0,0 +1,24 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+/* LZ compression.
+ *
+ * A small, fast LZ77 compressor in the style of LZ4: the output
+ * is a sequence of literal runs, each followed by a copy of
+ * earlier output given as (offset, length).  It trades ratio for
+ * speed, which suits compressing pages that are about to be
+ * swapped out.
+ *
+ * The compressor needs LZ_WORK_SIZE bytes of scratch space,
+ * passed in as WORK so that callers can keep it off the small
+ * kernel stacks.  Inputs are limited to LZ_MAX_INPUT bytes. */
+
+#include <stddef.h>
+
+#define LZ_WORK_SIZE 8192
+#define LZ_MAX_INPUT 65535
+
+size_t lz_compress(const void *src, size_t src_size, void *dst, size_t dst_size, void *work);
+size_t lz_decompress(const void *src, size_t src_size, void *dst, size_t dst_size);
+
+#endif /* lib/kernel/lz.h */
@@ -0,0 +1,22 @@
+#ifndef __LIB_MMAN_H
+#define __LIB_MMAN_H
+
+/* Memory-mapping flags and advice, shared by user programs and
+ * the kernel. */
+
+/* May be or'd into mmap()'s WRITABLE argument: read the whole
+ * mapping in at once rather than page by page as it is touched. */
+#define MAP_POPULATE 0x2
+
+/* Advice for madvise(). */
+#define MADV_NORMAL 0     /* No special treatment. */
+#define MADV_RANDOM 1     /* Expect random access: no read-ahead. */
+#define MADV_SEQUENTIAL 2 /* Expect sequential access: read ahead hard. */
+#define MADV_WILLNEED 3   /* Expect access soon: read it in now. */
+#define MADV_DONTNEED 4   /* Do not expect access: drop the pages. */
+
+/* Flags for msync(); exactly one must be given. */
+#define MS_ASYNC 1 /* Leave the writes to the writeback daemon. */
+#define MS_SYNC 4  /* Write before returning. */
+
+#endif /* lib/mman.h */
@@ -0,0 +1,38 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+/* Resource usage of a process, shared by user programs and the
+ * kernel. */
+
+/* Kinds of page fault. */
+#define RUSAGE_MINOR 0       /* Mapped a page without reading the disk. */
+#define RUSAGE_MAJOR 1       /* Read the page from its file or from swap. */
+#define RUSAGE_COW 2         /* Wrote to a frame shared copy-on-write. */
+#define RUSAGE_STACK 3       /* Mapped a new page of the stack. */
+#define RUSAGE_FAULT_KINDS 4 /* Number of kinds. */
+
+/* Fault latency histogram.  Bucket I counts faults that took fewer
+ * than 2**(I + RUSAGE_HIST_SHIFT) TSC cycles but, past bucket 0, at
+ * least half that; the last bucket also takes everything slower. */
+#define RUSAGE_HIST_SHIFT 10
+#define RUSAGE_HIST_BUCKETS 16
+
+/* Page faults of one kind. */
+struct fault_usage {
+    long long cnt;                       /* Faults handled. */
+    long long cycles;                    /* TSC cycles spent on them. */
+    long long hist[RUSAGE_HIST_BUCKETS]; /* Latency histogram. */
+};
+
+/* What getrusage() reports. */
+struct rusage {
+    struct fault_usage faults[RUSAGE_FAULT_KINDS];
+    long long rss;       /* Pages now resident. */
+    long long rss_peak;  /* Most pages ever resident at once. */
+    long long rss_limit; /* Resident set limit, or 0. */
+    long long swap;      /* Pages now in swap. */
+    long long swap_peak; /* Most pages ever in swap at once. */
+    long long evicted;   /* Frames evicted to keep under RSS_LIMIT. */
+};
+
+#endif /* lib/rusage.h */
@@ -36,6 +36,12 @@ enum {
 
     SYS_MOUNT,
     SYS_UMOUNT,
+
+    /* Extra for Project 3 */
+    SYS_MADVISE,       /* Advise on expected use of memory. */
+    SYS_MSYNC,         /* Write a file mapping back to its file. */
+    SYS_SET_RSS_LIMIT, /* Limit the resident set of the process. */
+    SYS_GETRUSAGE,     /* Report the resource usage of the process. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -2,6 +2,8 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <debug.h>
+#include <mman.h>
+#include <rusage.h>
 #include <stdbool.h>
 #include <stddef.h>
 
@@ -41,6 +43,10 @@ int dup2(int oldfd, int newfd);
 /* Project 3 and optionally project 4. */
 void *mmap(void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap(void *addr);
+int madvise(void *addr, size_t length, int advice);
+int msync(void *addr, size_t length, int flags);
+int set_rss_limit(size_t pages);
+int getrusage(struct rusage *usage);
 
 /* Project 4 only. */
 bool chdir(const char *dir);
@@ -76,4 +82,13 @@ static inline long long get_fs_disk_write_cnt(void) {
     return write_cnt;
 }
 
+/* Returns the number of page faults of KIND, one of the RUSAGE_*
+ * kinds, that this process has taken, or of all kinds if KIND is
+ * RUSAGE_FAULT_KINDS. */
+static inline long long get_page_fault_cnt(int kind) {
+    long long fault_cnt;
+    asm volatile("int $0x45" : "=a"(fault_cnt) : "a"((long long)kind));
+    return fault_cnt;
+}
+
 #endif /* lib/user/syscall.h */
@@ -12,8 +12,12 @@ uint64_t *pml4_create(void);
 bool pml4_for_each(uint64_t *, pte_for_each_func *, void *);
 void pml4_destroy(uint64_t *pml4);
 void pml4_activate(uint64_t *pml4);
+void pml4_pcid_init(void);
+void pml4_print_stats(void);
 void *pml4_get_page(uint64_t *pml4, const void *upage);
 bool pml4_set_page(uint64_t *pml4, void *upage, void *kpage, bool rw);
+bool pml4_set_huge_page(uint64_t *pml4, void *upage, void *kpage, bool rw);
+bool pml4_is_huge(uint64_t *pml4, const void *upage);
 void pml4_clear_page(uint64_t *pml4, void *upage);
 bool pml4_is_dirty(uint64_t *pml4, const void *upage);
 void pml4_set_dirty(uint64_t *pml4, const void *upage, bool dirty);
@@ -41,5 +41,13 @@
 #define PTE_U 0x4                           /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20                          /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40                          /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80                         /* 1=2 MB page (PDEs only). */
+
+/* A page directory entry with PTE_PS set maps a huge page: 2 MB
+   of physically contiguous, 2 MB-aligned memory, with no page
+   table below it. */
+#define HPGSIZE (1UL << PDXSHIFT)     /* Bytes in a huge page. */
+#define HPGPAGES (HPGSIZE / PGSIZE)   /* Pages in a huge page. */
+#define HPGMASK (HPGSIZE - 1)         /* Huge page offset bits. */
 
 #endif /* threads/pte.h */
@@ -124,6 +124,7 @@ struct thread {
 #ifdef VM
     /* Table for whole virtual memory owned by thread. */
     struct supplemental_page_table spt;
+    uint64_t user_rsp; /* User %rsp on entry to the current system call. */
 #endif
 
     /* Owned by thread.c. */
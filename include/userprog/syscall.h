@@ -9,12 +9,17 @@
 #define dev_printf(...) printf(__VA_ARGS__)
 #endif
 
+#include "filesys/off_t.h"
+#include <stddef.h>
+
 typedef int pid_t;
+struct intr_frame;
+struct rusage;
 
 void syscall_init(void);
 void halt(void);
 void exit(int exit_code);
-int fork(const char *thread_name);
+int fork(const char *thread_name, struct intr_frame *ifp);
 int exec(const char *file);
 int wait(pid_t pid);
 int create(const char *file, unsigned initial_size);
@@ -26,5 +31,13 @@ int write(int fd, const void *buffer, unsigned length);
 void seek(int fd, unsigned position);
 unsigned tell(int fd);
 void close(int fd);
+#ifdef VM
+void *mmap(void *addr, size_t length, int writable, int fd, off_t offset);
+void munmap(void *addr);
+int madvise(void *addr, size_t length, int advice);
+int msync(void *addr, size_t length, int flags);
+int set_rss_limit(size_t pages);
+int getrusage(struct rusage *usage);
+#endif
 
 #endif /* userprog/syscall.h */
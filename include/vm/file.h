@@ -6,10 +6,16 @@
 struct page;
 enum vm_type;
 
-struct file_page {};
+struct file_page {
+    struct file *file; /* Mapped file, owned by the page's area. */
+    off_t offset;      /* Offset of the page in FILE. */
+    size_t read_bytes; /* Bytes backed by FILE; the rest are zero. */
+    bool cached;       /* Maps the page cache's copy of the page? */
+};
 
 void vm_file_init(void);
 bool file_backed_initializer(struct page *page, enum vm_type type, void *kva);
+bool file_backed_write_back(struct page *page);
 void *do_mmap(void *addr, size_t length, int writable, struct file *file, off_t offset);
 void do_munmap(void *va);
 #endif
@@ -0,0 +1,12 @@
+#ifndef VM_KSM_H
+#define VM_KSM_H
+#include <stdint.h>
+
+struct frame;
+
+void ksm_init(void);
+uint64_t ksm_checksum(const void *kva);
+struct frame *ksm_insert(struct frame *frame);
+void ksm_remove(struct frame *frame);
+
+#endif /* vm/ksm.h */
@@ -0,0 +1,19 @@
+#ifndef VM_PCACHE_H
+#define VM_PCACHE_H
+#include "devices/disk.h"
+#include "filesys/off_t.h"
+#include <stdbool.h>
+
+struct frame;
+struct inode;
+
+void pcache_init(void);
+off_t pcache_read(struct inode *inode, void *buffer, off_t size, off_t offset, bool fill);
+off_t pcache_write(struct inode *inode, const void *buffer, off_t size, off_t offset);
+void pcache_drop(struct inode *inode);
+struct frame *pcache_find(disk_sector_t sector, off_t offset);
+struct frame *pcache_insert(struct frame *frame, disk_sector_t sector, off_t offset);
+void pcache_remove(struct frame *frame);
+void pcache_print_stats(void);
+
+#endif /* vm/pcache.h */
@@ -0,0 +1,26 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct disk;
+struct supplemental_page_table;
+
+/* Slot number meaning "not in swap". */
+#define SWAP_SLOT_NONE SIZE_MAX
+
+/* Most pages written to swap with one disk command. */
+#define SWAP_CLUSTER 8
+
+void swap_init(struct disk *);
+size_t swap_out_page(struct supplemental_page_table *spt, const void *kva);
+void swap_in_page(size_t slot, void *kva);
+bool swap_is_cached(size_t slot);
+void swap_write_slot(size_t slot, const void *kva);
+void swap_free(struct supplemental_page_table *spt, size_t slot);
+void swap_plug(void);
+void swap_unplug(void);
+void swap_print_stats(void);
+
+#endif /* vm/swap.h */
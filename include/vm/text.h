@@ -0,0 +1,14 @@
+#ifndef VM_TEXT_H
+#define VM_TEXT_H
+#include <stdbool.h>
+
+struct frame;
+struct page;
+
+void text_init(void);
+struct frame *text_find(struct page *page);
+bool text_insert(struct page *page);
+void text_remove(struct frame *frame);
+void text_print_stats(void);
+
+#endif /* vm/text.h */
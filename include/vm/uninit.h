@@ -19,4 +19,5 @@ struct uninit_page {
 };
 
 void uninit_new(struct page *page, void *va, vm_initializer *init, enum vm_type type, void *aux, bool (*initializer)(struct page *, enum vm_type, void *kva));
+bool uninit_transmute(struct page *page);
 #endif
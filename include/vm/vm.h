@@ -1,6 +1,11 @@
 #ifndef VM_VM_H
 #define VM_VM_H
+#include "devices/disk.h"
 #include "threads/palloc.h"
+#include <hash.h>
+#include <itree.h>
+#include <list.h>
+#include <rusage.h>
 #include <stdbool.h>
 
 enum vm_type {
@@ -26,11 +31,16 @@ enum vm_type {
 
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/ksm.h"
+#include "vm/pcache.h"
+#include "vm/text.h"
 #include "vm/uninit.h"
+#include "vm/vma.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
 #endif
 
+struct inode;
 struct page_operations;
 struct thread;
 
@@ -46,6 +56,12 @@ struct page {
     struct frame *frame; /* Back reference for frame */
 
     /* Your implementation */
+    bool writable;               /* May the user process write to it? */
+    struct thread *owner;        /* Thread whose page table maps it. */
+    struct vma *vma;             /* Area the page belongs to, or NULL. */
+    struct hash_elem spt_elem;   /* Element in the SPT's page hash. */
+    struct list_elem vma_elem;   /* Element in VMA's page list. */
+    struct list_elem frame_elem; /* Element in FRAME's page list. */
 
     /* Per-type data are binded into the union.
      * Each function automatically detects the current union */
@@ -59,10 +75,41 @@ struct page {
     };
 };
 
-/* The representation of "frame" */
+/* The representation of "frame".
+ *
+ * After fork, a frame may back the same page of several
+ * processes at once.  While it does, every one of them maps it
+ * read-only, and the first to write gets a copy of its own.  A
+ * frame of the page cache is the exception: the file pages that
+ * map it share it on purpose, and map it writable if they are. */
+/* Frame flags. */
+#define FRAME_USED 0x1        /* Holds a page, and is in the frame table. */
+#define FRAME_ZERO 0x2        /* The shared zero frame, never written. */
+#define FRAME_KSM 0x4         /* In the same-page merging index. */
+#define FRAME_CACHE 0x8       /* In the page cache. */
+#define FRAME_REFERENCED 0x10 /* Cached page read or written since the clock hand passed. */
+
+/* The descriptor of a frame of the user pool.  There is one for
+ * every frame, in an array indexed by frame number, whether or
+ * not it is in use. */
 struct frame {
     void *kva;
-    struct page *page;
+    struct list pages; /* Reverse map: pages mapping the frame. */
+
+    struct list_elem elem;  /* Element in the frame table. */
+    unsigned flags;         /* FRAME_* flags. */
+    unsigned pin_cnt;       /* Skipped by eviction while nonzero. */
+    unsigned map_cnt;       /* Number of PAGES. */
+    struct text_page *text; /* Entry in the text cache, or NULL. */
+
+    /* Same-page merging. */
+    uint64_t checksum;         /* Contents when last scanned. */
+    struct hash_elem ksm_elem; /* Element in the index, if FRAME_KSM. */
+
+    /* Page cache. */
+    disk_sector_t cache_sector;  /* Inode of the cached file. */
+    off_t cache_offset;          /* Offset of the page in the file. */
+    struct hash_elem cache_elem; /* Element in the cache, if FRAME_CACHE. */
 };
 
 /* The function table for page operations.
@@ -83,9 +130,31 @@ struct page_operations {
     (page)->operations->destroy(page)
 
 /* Representation of current process's memory space.
- * We don't want to force you to obey any specific design for this struct.
- * All designs up to you for this. */
-struct supplemental_page_table {};
+ *
+ * The address space is described by its virtual memory areas,
+ * kept in an interval tree so that range operations (mmap
+ * overlap checks, munmap, stack growth, fork) cost O(log n + k)
+ * however many pages the areas span.  A struct page exists only
+ * for pages that have been touched; those are also hashed by
+ * page-aligned address, so the fault path finds them in O(1). */
+struct supplemental_page_table {
+    struct hash pages; /* Pages created so far, keyed by va. */
+    struct itree vmas; /* Virtual memory areas, keyed by range. */
+    struct vma *stack; /* The stack area, which grows down. */
+
+    size_t swap_cnt;  /* Pages now in swap. */
+    size_t swap_peak; /* Most pages ever in swap at once. */
+
+    /* Resident set.  A page counts while it maps a frame, even one
+     * it shares. */
+    size_t rss_cnt;      /* Pages now mapping a frame. */
+    size_t rss_peak;     /* Most pages ever mapping frames at once. */
+    size_t rss_limit;    /* Most pages to keep resident, or 0. */
+    long long evict_cnt; /* Frames evicted to keep under RSS_LIMIT. */
+
+    /* Page faults handled, by RUSAGE_* kind. */
+    struct fault_usage faults[RUSAGE_FAULT_KINDS];
+};
 
 #include "threads/thread.h"
 void supplemental_page_table_init(struct supplemental_page_table *spt);
@@ -102,6 +171,47 @@ bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user, bool write
 bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page(struct page *page);
 bool vm_claim_page(void *va);
+void vm_free_frame(struct page *page);
+struct frame *vm_cache_get(struct inode *inode, off_t offset, bool fill);
+void vm_cache_put(struct frame *frame);
+void vm_cache_drop(struct inode *inode);
 enum vm_type page_get_type(struct page *page);
+void vm_print_stats(void);
+int vm_madvise(void *addr, size_t size, int advice);
+int vm_msync(void *addr, size_t size, int flags);
+int vm_set_rss_limit(size_t pages);
+void vm_getrusage(struct rusage *usage);
+void vm_print_rusage(const char *name);
+
+/* -evict-fifo: evict frames in allocation order, ignoring use. */
+extern bool vm_evict_fifo;
+
+/* -fault-around=N: pages of an executable segment mapped per fault. */
+extern size_t vm_fault_around;
+
+/* -stack-limit=KB: largest the user stack may grow, in bytes. */
+extern size_t vm_stack_limit;
+
+/* -wb-interval=MS, -wb-batch=N: how often the writeback daemon
+ * runs (0 turns it off) and how many pages it writes at once. */
+extern unsigned vm_wb_interval;
+extern size_t vm_wb_batch;
+
+/* -ksm=N: frames the same-page merging scanner visits every 100 ms
+ * (0 turns it off). */
+extern size_t vm_ksm_pages;
+
+/* -rss-limit=N: resident pages a new process may keep before its
+ * faults evict its own frames (0 for no limit). */
+extern size_t vm_rss_limit;
+
+/* -rusage: print each process's fault counts when it exits. */
+extern bool vm_rusage_on_exit;
+
+/* -no-huge: never map anonymous memory with 2 MB huge pages. */
+extern bool vm_huge_pages;
+
+/* Number of programs loaded, for the fault statistics. */
+extern long long vm_exec_cnt;
 
 #endif /* VM_VM_H */
@@ -0,0 +1,54 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include "filesys/off_t.h"
+#include "vm/vm.h"
+#include <itree.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct file;
+struct page;
+struct supplemental_page_table;
+
+/* What a virtual memory area holds. */
+enum vma_kind {
+    VMA_CODE,  /* Read-only executable segment. */
+    VMA_DATA,  /* Writable executable segment (data, bss). */
+    VMA_STACK, /* User stack, which grows down. */
+    VMA_MMAP,  /* File mapping made by mmap(). */
+};
+
+/* A virtual memory area: a page-aligned range of user addresses
+ * whose pages share a type, protection and backing store.  Its
+ * pages are created one at a time, when they are first touched;
+ * until then the area is all there is. */
+struct vma {
+    struct itree_elem elem; /* Range [start, end) in the SPT's tree. */
+    enum vma_kind kind;
+    enum vm_type type;  /* Type of the pages it creates. */
+    bool writable;      /* May its pages be written? */
+    struct file *file;  /* Backing file, owned by the area, or NULL. */
+    off_t offset;       /* Offset in FILE of the area's first byte. */
+    size_t file_bytes;  /* Bytes read from FILE; the rest are zero. */
+    struct list pages;  /* Pages created so far. */
+
+    /* Read-ahead state, for executable segments and for areas
+     * advised MADV_SEQUENTIAL. */
+    int advice;      /* Last MADV_* given for the area. */
+    void *ra_next;   /* Fault address that would continue a run. */
+    size_t ra_pages; /* Pages mapped ahead of the last fault. */
+};
+
+#define vma_start(VMA) ((void *)(VMA)->elem.start)
+#define vma_end(VMA) ((void *)(VMA)->elem.end)
+#define vma_size(VMA) ((size_t)((VMA)->elem.end - (VMA)->elem.start))
+
+struct vma *vma_create(struct supplemental_page_table *spt, void *start, size_t size, enum vma_kind kind, enum vm_type type, bool writable, struct file *file, off_t offset, size_t file_bytes);
+void vma_destroy(struct supplemental_page_table *spt, struct vma *vma);
+struct vma *vma_find(struct supplemental_page_table *spt, const void *va);
+bool vma_overlaps(struct supplemental_page_table *spt, const void *start, size_t size);
+bool vma_grow_down(struct supplemental_page_table *spt, struct vma *vma, void *new_start);
+bool vma_load_page(struct page *page, void *aux);
+
+#endif /* vm/vma.h */
@@ -93,9 +93,11 @@ static void release_console(void) {
     }
 }
 
+#ifndef NDEBUG
 /* Returns true if the current thread has the console lock,
    false otherwise. */
 static bool console_locked_by_current_thread(void) { return (intr_context() || !use_console_lock || lock_held_by_current_thread(&console_lock)); }
+#endif
 
 /* The standard vprintf() function,
    which is like printf() but uses a va_list.
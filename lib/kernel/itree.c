@@ -0,0 +1,244 @@
+/* Interval tree.
+
+   See itree.h for basic information. */
+
+#include "itree.h"
+#include "../debug.h"
+
+static int height(const struct itree_elem *);
+static void update(struct itree_elem *);
+static void replace_child(struct itree *, struct itree_elem *parent, struct itree_elem *old, struct itree_elem *new);
+static struct itree_elem *rotate_left(struct itree *, struct itree_elem *);
+static struct itree_elem *rotate_right(struct itree *, struct itree_elem *);
+static void rebalance(struct itree *, struct itree_elem *);
+static struct itree_elem *subtree_first_overlap(struct itree_elem *, uint64_t start, uint64_t end);
+
+/* Initializes T as an empty interval tree. */
+void itree_init(struct itree *t) {
+    ASSERT(t != NULL);
+
+    t->root = NULL;
+    t->elem_cnt = 0;
+}
+
+/* Inserts E, whose START and END must already be set, into T.
+   Elements with equal starts are kept in insertion order. */
+void itree_insert(struct itree *t, struct itree_elem *e) {
+    struct itree_elem *parent = NULL;
+    struct itree_elem **link = &t->root;
+
+    ASSERT(e->start < e->end);
+
+    while (*link != NULL) {
+        parent = *link;
+        link = e->start < parent->start ? &parent->left : &parent->right;
+    }
+
+    e->parent = parent;
+    e->left = e->right = NULL;
+    *link = e;
+    t->elem_cnt++;
+    rebalance(t, e);
+}
+
+/* Removes E, which must be in T, from T. */
+void itree_remove(struct itree *t, struct itree_elem *e) {
+    struct itree_elem *fix;
+
+    if (e->left != NULL && e->right != NULL) {
+        /* Move E's in-order successor S into E's place. */
+        struct itree_elem *s = e->right;
+        while (s->left != NULL)
+            s = s->left;
+
+        if (s->parent == e)
+            fix = s;
+        else {
+            fix = s->parent;
+            fix->left = s->right;
+            if (s->right != NULL)
+                s->right->parent = fix;
+            s->right = e->right;
+            s->right->parent = s;
+        }
+        s->left = e->left;
+        s->left->parent = s;
+        replace_child(t, e->parent, e, s);
+    } else {
+        fix = e->parent;
+        replace_child(t, e->parent, e, e->left != NULL ? e->left : e->right);
+    }
+
+    t->elem_cnt--;
+    rebalance(t, fix);
+}
+
+/* Returns the element of T with the lowest start whose interval
+   contains POINT, or a null pointer if there is none. */
+struct itree_elem *itree_find(struct itree *t, uint64_t point) { return itree_first_overlap(t, point, point + 1); }
+
+/* Returns the element of T with the lowest start that overlaps
+   [START, END), or a null pointer if no element does. */
+struct itree_elem *itree_first_overlap(struct itree *t, uint64_t start, uint64_t end) {
+    ASSERT(start < end);
+
+    return subtree_first_overlap(t->root, start, end);
+}
+
+/* Returns the element after E, in order of start, that overlaps
+   [START, END), or a null pointer if there are no more.  E is
+   usually the result of a previous itree_first_overlap() or
+   itree_next_overlap() with the same range. */
+struct itree_elem *itree_next_overlap(struct itree_elem *e, uint64_t start, uint64_t end) {
+    struct itree_elem *found;
+
+    if ((found = subtree_first_overlap(e->right, start, end)) != NULL)
+        return found;
+
+    /* Climb until we leave a left subtree; that parent and its
+       right subtree come next in order. */
+    for (; e->parent != NULL; e = e->parent) {
+        struct itree_elem *p = e->parent;
+
+        if (p->left != e)
+            continue;
+        if (p->start >= end)
+            return NULL;
+        if (p->end > start)
+            return p;
+        if ((found = subtree_first_overlap(p->right, start, end)) != NULL)
+            return found;
+    }
+    return NULL;
+}
+
+/* Returns the element of T with the lowest start, or a null
+   pointer if T is empty. */
+struct itree_elem *itree_first(struct itree *t) {
+    struct itree_elem *e = t->root;
+
+    if (e != NULL)
+        while (e->left != NULL)
+            e = e->left;
+    return e;
+}
+
+/* Returns the element after E in order of start, or a null
+   pointer if E is the last. */
+struct itree_elem *itree_next(struct itree_elem *e) {
+    if (e->right != NULL) {
+        e = e->right;
+        while (e->left != NULL)
+            e = e->left;
+        return e;
+    }
+    while (e->parent != NULL && e->parent->right == e)
+        e = e->parent;
+    return e->parent;
+}
+
+/* Returns the number of elements in T. */
+size_t itree_size(struct itree *t) { return t->elem_cnt; }
+
+/* Returns true if T contains no elements, false otherwise. */
+bool itree_empty(struct itree *t) { return t->elem_cnt == 0; }
+
+/* Returns the height of the subtree rooted at E. */
+static int height(const struct itree_elem *e) { return e != NULL ? e->height : 0; }
+
+/* Recomputes E's height and max_end from its children. */
+static void update(struct itree_elem *e) {
+    int lh = height(e->left), rh = height(e->right);
+
+    e->height = (lh > rh ? lh : rh) + 1;
+    e->max_end = e->end;
+    if (e->left != NULL && e->left->max_end > e->max_end)
+        e->max_end = e->left->max_end;
+    if (e->right != NULL && e->right->max_end > e->max_end)
+        e->max_end = e->right->max_end;
+}
+
+/* Makes NEW take OLD's place as PARENT's child, or as T's root
+   if PARENT is null. */
+static void replace_child(struct itree *t, struct itree_elem *parent, struct itree_elem *old, struct itree_elem *new) {
+    if (parent == NULL)
+        t->root = new;
+    else if (parent->left == old)
+        parent->left = new;
+    else
+        parent->right = new;
+    if (new != NULL)
+        new->parent = parent;
+}
+
+/* Rotates the subtree rooted at X to the left and returns its
+   new root. */
+static struct itree_elem *rotate_left(struct itree *t, struct itree_elem *x) {
+    struct itree_elem *y = x->right;
+
+    replace_child(t, x->parent, x, y);
+    x->right = y->left;
+    if (x->right != NULL)
+        x->right->parent = x;
+    y->left = x;
+    x->parent = y;
+    update(x);
+    update(y);
+    return y;
+}
+
+/* Rotates the subtree rooted at X to the right and returns its
+   new root. */
+static struct itree_elem *rotate_right(struct itree *t, struct itree_elem *x) {
+    struct itree_elem *y = x->left;
+
+    replace_child(t, x->parent, x, y);
+    x->left = y->right;
+    if (x->left != NULL)
+        x->left->parent = x;
+    y->right = x;
+    x->parent = y;
+    update(x);
+    update(y);
+    return y;
+}
+
+/* Walks from E up to the root, restoring the AVL balance and the
+   max_end augmentation along the way. */
+static void rebalance(struct itree *t, struct itree_elem *e) {
+    for (; e != NULL; e = e->parent) {
+        int balance;
+
+        update(e);
+        balance = height(e->left) - height(e->right);
+        if (balance > 1) {
+            if (height(e->left->left) < height(e->left->right))
+                rotate_left(t, e->left);
+            e = rotate_right(t, e);
+        } else if (balance < -1) {
+            if (height(e->right->right) < height(e->right->left))
+                rotate_right(t, e->right);
+            e = rotate_left(t, e);
+        }
+    }
+}
+
+/* Returns the element with the lowest start in the subtree rooted
+   at E that overlaps [START, END), or a null pointer.
+
+   Descending left whenever the left subtree reaches past START is
+   safe: if nothing there overlaps, then everything there starts
+   at or after END, and so does everything else in the subtree. */
+static struct itree_elem *subtree_first_overlap(struct itree_elem *e, uint64_t start, uint64_t end) {
+    while (e != NULL && e->max_end > start) {
+        if (e->left != NULL && e->left->max_end > start)
+            e = e->left;
+        else if (e->start >= end)
+            return NULL;
+        else if (e->end > start)
+            return e;
+        else
+            e = e->right;
+    }
+    return NULL;
+}
@@ -0,0 +1,167 @@
+/* LZ compression.
+
+   See lz.h for basic information.
+
+   Compressed data is a series of sequences.  Each begins with a
+   token byte whose high nibble is the length of the literal run
+   that follows and whose low nibble is the match length minus
+   LZ_MIN_MATCH; a nibble of 15 means more length follows in
+   extra bytes, each added in, until one is less than 255.  Then
+   come the literals, and then, except in the last sequence, the
+   match: a 2-byte little-endian offset back into the output,
+   followed by any extra match length bytes.  The last sequence
+   is the one whose literals end the input. */
+
+#include "lz.h"
+#include "../debug.h"
+#include <stdint.h>
+#include <string.h>
+
+/* Shortest match worth encoding. */
+#define LZ_MIN_MATCH 4
+
+/* Slots in the compressor's hash table of recent positions. */
+#define HASH_BITS 12
+#define HASH_SIZE (1 << HASH_BITS)
+
+/* Marks an empty hash slot. */
+#define NO_POS UINT16_MAX
+
+static size_t put_length(uint8_t *dst, size_t dst_size, size_t pos, size_t len);
+
+/* Reads 4 bytes at P, which need not be aligned. */
+static inline uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+/* Returns the hash table slot for the 4 bytes V. */
+static inline unsigned hash4(uint32_t v) { return (v * 2654435761u) >> (32 - HASH_BITS); }
+
+/* Compresses the SRC_SIZE bytes at SRC into the DST_SIZE bytes at
+   DST, using the LZ_WORK_SIZE bytes at WORK as scratch space.
+   Returns the compressed size, or 0 if it would not fit in
+   DST_SIZE bytes. */
+size_t lz_compress(const void *src_, size_t src_size, void *dst_, size_t dst_size, void *work) {
+    const uint8_t *src = src_;
+    uint8_t *dst = dst_;
+    uint16_t *table = work;
+    size_t anchor = 0, i = 0, out = 0;
+
+    ASSERT(src_size <= LZ_MAX_INPUT);
+    ASSERT(HASH_SIZE * sizeof *table <= LZ_WORK_SIZE);
+
+    memset(table, 0xff, HASH_SIZE * sizeof *table);
+
+    for (;;) {
+        size_t match = 0, offset = 0, lit, token;
+
+        /* Find the next match, or run out of input. */
+        while (i + LZ_MIN_MATCH <= src_size) {
+            uint32_t v = read32(src + i);
+            unsigned h = hash4(v);
+            size_t cand = table[h];
+
+            table[h] = i;
+            if (cand != NO_POS && read32(src + cand) == v) {
+                match = LZ_MIN_MATCH;
+                while (i + match < src_size && src[cand + match] == src[i + match])
+                    match++;
+                offset = i - cand;
+                break;
+            }
+            i++;
+        }
+        if (match == 0)
+            i = src_size;
+
+        /* Emit the literals before it, then the match itself. */
+        lit = i - anchor;
+        token = out++;
+        if (token >= dst_size)
+            return 0;
+        dst[token] = (lit < 15 ? lit : 15) << 4;
+        if (lit >= 15 && (out = put_length(dst, dst_size, out, lit - 15)) == 0)
+            return 0;
+        if (out + lit > dst_size)
+            return 0;
+        memcpy(dst + out, src + anchor, lit);
+        out += lit;
+        if (match == 0)
+            return out;
+
+        if (out + 2 > dst_size)
+            return 0;
+        dst[out++] = offset;
+        dst[out++] = offset >> 8;
+        dst[token] |= match - LZ_MIN_MATCH < 15 ? match - LZ_MIN_MATCH : 15;
+        if (match - LZ_MIN_MATCH >= 15 && (out = put_length(dst, dst_size, out, match - LZ_MIN_MATCH - 15)) == 0)
+            return 0;
+
+        i += match;
+        anchor = i;
+    }
+}
+
+/* Decompresses the SRC_SIZE bytes at SRC into the DST_SIZE bytes
+   at DST.  Returns the decompressed size, or 0 if SRC is not
+   valid compressed data or does not fit in DST_SIZE bytes. */
+size_t lz_decompress(const void *src_, size_t src_size, void *dst_, size_t dst_size) {
+    const uint8_t *src = src_;
+    uint8_t *dst = dst_;
+    size_t in = 0, out = 0;
+
+    while (in < src_size) {
+        unsigned token = src[in++];
+        size_t lit = token >> 4, match = (token & 15) + LZ_MIN_MATCH, offset;
+        uint8_t b;
+
+        if (lit == 15)
+            do {
+                if (in >= src_size)
+                    return 0;
+                lit += b = src[in++];
+            } while (b == 255);
+        if (lit > src_size - in || lit > dst_size - out)
+            return 0;
+        memcpy(dst + out, src + in, lit);
+        in += lit;
+        out += lit;
+        if (in == src_size)
+            return out;
+
+        if (src_size - in < 2)
+            return 0;
+        offset = src[in] | (size_t)src[in + 1] << 8;
+        in += 2;
+        if ((token & 15) == 15)
+            do {
+                if (in >= src_size)
+                    return 0;
+                match += b = src[in++];
+            } while (b == 255);
+        if (offset == 0 || offset > out || match > dst_size - out)
+            return 0;
+
+        /* The copy may overlap its own output, so go bytewise. */
+        for (; match > 0; match--, out++)
+            dst[out] = dst[out - offset];
+    }
+    return 0;
+}
+
+/* Writes the extra length bytes for LEN at DST[POS], within
+   DST_SIZE bytes.  Returns the position after them, or 0 if they
+   do not fit. */
+static size_t put_length(uint8_t *dst, size_t dst_size, size_t pos, size_t len) {
+    for (; len >= 255; len -= 255) {
+        if (pos >= dst_size)
+            return 0;
+        dst[pos++] = 255;
+    }
+    if (pos >= dst_size)
+        return 0;
+    dst[pos++] = len;
+    return pos;
+}
@@ -82,6 +82,14 @@ void *mmap(void *addr, size_t length, int writable, int fd, off_t offset) { retu
 
 void munmap(void *addr) { syscall1(SYS_MUNMAP, addr); }
 
+int madvise(void *addr, size_t length, int advice) { return syscall3(SYS_MADVISE, addr, length, advice); }
+
+int msync(void *addr, size_t length, int flags) { return syscall3(SYS_MSYNC, addr, length, flags); }
+
+int set_rss_limit(size_t pages) { return syscall1(SYS_SET_RSS_LIMIT, pages); }
+
+int getrusage(struct rusage *usage) { return syscall1(SYS_GETRUSAGE, usage); }
+
 bool chdir(const char *dir) { return syscall1(SYS_CHDIR, dir); }
 
 bool mkdir(const char *dir) { return syscall1(SYS_MKDIR, dir); }
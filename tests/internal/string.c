@@ -0,0 +1,142 @@
+/* Test program for the block and string routines in lib/string.c.
+
+   Checks memcpy(), memmove(), memset(), memcmp() and strlen()
+   against simple byte-at-a-time reference versions over every
+   small alignment combination, then times them against the
+   references for block sizes from 8 bytes to 64 kB.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include "threads/test.h"
+#include "intrinsic.h"
+#include <debug.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Largest block size tested. */
+#define MAX_SIZE (64 * 1024)
+
+/* Number of timed calls per block size. */
+#define ROUNDS 64
+
+static unsigned char src_buf[MAX_SIZE + 64];
+static unsigned char dst_buf[MAX_SIZE + 64];
+static unsigned char ref_buf[MAX_SIZE + 64];
+
+static void verify(void);
+static void bench(void);
+
+/* Test and time the string.h block routines. */
+void test(void) {
+    verify();
+    bench();
+}
+
+/* Byte-at-a-time references. */
+static void ref_memmove(unsigned char *dst, const unsigned char *src, size_t size) {
+    if (dst < src)
+        while (size-- > 0)
+            *dst++ = *src++;
+    else
+        while (size-- > 0)
+            dst[size] = src[size];
+}
+
+static int ref_memcmp(const unsigned char *a, const unsigned char *b, size_t size) {
+    for (; size-- > 0; a++, b++)
+        if (*a != *b)
+            return *a > *b ? +1 : -1;
+    return 0;
+}
+
+static void fill_random(unsigned char *buf, size_t size) {
+    random_bytes(buf, size);
+}
+
+/* Checks each routine for sizes up to 300 bytes at every
+   source/destination offset within a word. */
+static void verify(void) {
+    size_t size, sofs, dofs;
+
+    printf("verifying:");
+    for (size = 0; size < 300; size = size < 20 ? size + 1 : size * 3 / 2) {
+        printf(" %zu", size);
+        for (sofs = 0; sofs < 8; sofs++)
+            for (dofs = 0; dofs < 8; dofs++) {
+                unsigned char *s = src_buf + sofs, *d = dst_buf + dofs;
+
+                /* memcpy. */
+                fill_random(src_buf, sizeof src_buf);
+                fill_random(dst_buf, sizeof dst_buf);
+                memcpy(ref_buf, dst_buf, sizeof dst_buf);
+                memcpy(d, s, size);
+                ref_memmove(ref_buf + dofs, s, size);
+                ASSERT(ref_memcmp(dst_buf, ref_buf, sizeof dst_buf) == 0);
+
+                /* memmove, overlapping in both directions. */
+                memcpy(ref_buf, src_buf, sizeof src_buf);
+                memmove(src_buf + dofs, src_buf + sofs, size);
+                ref_memmove(ref_buf + dofs, ref_buf + sofs, size);
+                ASSERT(ref_memcmp(src_buf, ref_buf, sizeof src_buf) == 0);
+
+                /* memset. */
+                memcpy(ref_buf, dst_buf, sizeof dst_buf);
+                memset(d, 0xa5, size);
+                for (size_t i = 0; i < size; i++)
+                    ref_buf[dofs + i] = 0xa5;
+                ASSERT(ref_memcmp(dst_buf, ref_buf, sizeof dst_buf) == 0);
+
+                /* memcmp, equal and differing at the last byte. */
+                memcpy(d, s, size);
+                ASSERT(memcmp(d, s, size) == 0);
+                if (size > 0) {
+                    d[size - 1] = s[size - 1] ^ 0x80;
+                    ASSERT(memcmp(d, s, size) == ref_memcmp(d, s, size));
+                }
+
+                /* strlen. */
+                memset(d, 'x', size);
+                d[size] = '\0';
+                ASSERT(strlen((char *)d) == size);
+            }
+    }
+    printf(" ok\n");
+}
+
+/* Prints the average cycles per call of each routine and its
+   reference for block sizes from 8 bytes to MAX_SIZE. */
+static void bench(void) {
+    size_t size;
+
+    printf("%8s %10s %10s %10s %10s %10s %10s\n", "size", "memcpy", "ref", "memset", "memcmp", "ref", "strlen");
+    for (size = 8; size <= MAX_SIZE; size *= 2) {
+        uint64_t t[6];
+        int i;
+
+        memset(src_buf, 'x', size);
+        src_buf[size] = '\0';
+        memcpy(dst_buf, src_buf, size);
+
+#define TIME(SLOT, EXPR)                                                                                                                             \
+    do {                                                                                                                                             \
+        uint64_t start = rdtsc();                                                                                                                    \
+        for (i = 0; i < ROUNDS; i++)                                                                                                                 \
+            EXPR;                                                                                                                                    \
+        t[SLOT] = (rdtsc() - start) / ROUNDS;                                                                                                        \
+    } while (0)
+
+        TIME(0, memcpy(dst_buf, src_buf, size));
+        TIME(1, ref_memmove(dst_buf, src_buf, size));
+        TIME(2, memset(dst_buf, 'x', size));
+        TIME(3, ASSERT(memcmp(dst_buf, src_buf, size) == 0));
+        TIME(4, ASSERT(ref_memcmp(dst_buf, src_buf, size) == 0));
+        TIME(5, ASSERT(strlen((char *)src_buf) == size));
+#undef TIME
+
+        printf("%8zu %10llu %10llu %10llu %10llu %10llu %10llu\n", size, t[0], t[1], t[2], t[3], t[4], t[5]);
+    }
+}
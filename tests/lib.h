@@ -4,6 +4,7 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <syscall.h>
 
 extern const char *test_name;
@@ -34,6 +35,7 @@ void fail(const char *, ...) PRINTF_FORMAT(1, 2) NO_RETURN;
     } while (0)
 
 void shuffle(void *, size_t cnt, size_t size);
+uint64_t rdtsc(void);
 
 void exec_children(const char *child_name, pid_t pids[], size_t child_cnt);
 void wait_children(pid_t pids[], size_t child_cnt);
@@ -0,0 +1,61 @@
+/* Measures the cost of memcpy(), memmove(), memset(), memcmp()
+   and strlen() on blocks from 8 bytes to 64 kB, in TSC cycles
+   per call.  Each figure is the best of several trials, so that
+   timer interrupts do not skew it. */
+
+#include "intrinsic.h"
+#include "tests/threads/tests.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Largest block size measured. */
+#define MAX_SIZE (64 * 1024)
+
+/* Calls per trial and trials per figure. */
+#define ROUNDS 16
+#define TRIALS 8
+
+static char src[MAX_SIZE + 8];
+static char dst[MAX_SIZE + 8];
+
+/* Results of the calls timed for their return value, stored so
+   that the calls are made even when ASSERT is compiled out. */
+static volatile int cmp_sink;
+static volatile size_t len_sink;
+
+/* Runs EXPR ROUNDS times per trial and returns the fewest cycles
+   per call seen over TRIALS trials. */
+#define BEST_OF(EXPR)                                                                                                                                  \
+    ({                                                                                                                                                 \
+        uint64_t best_ = UINT64_MAX;                                                                                                                   \
+        for (int t_ = 0; t_ < TRIALS; t_++) {                                                                                                          \
+            uint64_t start_ = rdtsc();                                                                                                                 \
+            for (int r_ = 0; r_ < ROUNDS; r_++)                                                                                                        \
+                EXPR;                                                                                                                                  \
+            uint64_t cycles_ = (rdtsc() - start_) / ROUNDS;                                                                                            \
+            if (cycles_ < best_)                                                                                                                       \
+                best_ = cycles_;                                                                                                                       \
+        }                                                                                                                                              \
+        best_;                                                                                                                                         \
+    })
+
+void test_perf_string(void) {
+    size_t size;
+
+    for (size = 8; size <= MAX_SIZE; size *= 8) {
+        memset(src, 'x', size);
+        src[size] = '\0';
+        memcpy(dst, src, size);
+
+        msg("perf memcpy-%zu %llu", size, BEST_OF(memcpy(dst, src, size)));
+        msg("perf memmove-%zu %llu", size, BEST_OF(memmove(dst + 1, dst, size)));
+        msg("perf memset-%zu %llu", size, BEST_OF(memset(dst, 'x', size)));
+        msg("perf memcmp-%zu %llu", size, BEST_OF(cmp_sink = memcmp(dst, src, size)));
+        if (cmp_sink != 0)
+            fail("memcmp() found a difference in equal blocks");
+        msg("perf strlen-%zu %llu", size, BEST_OF(len_sink = strlen(src)));
+        if (len_sink != size)
+            fail("strlen() returned %zu, not %zu", len_sink, size);
+    }
+}
@@ -0,0 +1,58 @@
+/* Measures the scheduler hot paths, in TSC cycles: a
+   thread_yield() with nobody else ready, and a semaphore
+   ping-pong round trip between two threads, which costs two
+   context switches.  Each figure is the best of several trials. */
+
+#include "intrinsic.h"
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include <debug.h>
+#include <stdio.h>
+
+/* Operations per trial and trials per figure. */
+#define ROUNDS 1000
+#define TRIALS 8
+
+static struct semaphore ping, pong;
+
+static thread_func pong_thread;
+
+void test_perf_switch(void) {
+    uint64_t best_yield = UINT64_MAX, best_trip = UINT64_MAX;
+    int t, r;
+
+    for (t = 0; t < TRIALS; t++) {
+        uint64_t start = rdtsc();
+        for (r = 0; r < ROUNDS; r++)
+            thread_yield();
+        uint64_t cycles = (rdtsc() - start) / ROUNDS;
+        if (cycles < best_yield)
+            best_yield = cycles;
+    }
+
+    sema_init(&ping, 0);
+    sema_init(&pong, 0);
+    thread_create("pong", thread_get_priority(), pong_thread, NULL);
+    for (t = 0; t < TRIALS; t++) {
+        uint64_t start = rdtsc();
+        for (r = 0; r < ROUNDS; r++) {
+            sema_up(&ping);
+            sema_down(&pong);
+        }
+        uint64_t cycles = (rdtsc() - start) / ROUNDS;
+        if (cycles < best_trip)
+            best_trip = cycles;
+    }
+
+    msg("perf yield %llu", best_yield);
+    msg("perf sema-round-trip %llu", best_trip);
+}
+
+/* Answers every ping with a pong. */
+static void pong_thread(void *aux UNUSED) {
+    for (int i = 0; i < ROUNDS * TRIALS; i++) {
+        sema_down(&ping);
+        sema_up(&pong);
+    }
+}
@@ -36,6 +36,8 @@ static const struct test tests[] = {
     {"mlfqs-nice-2", test_mlfqs_nice_2},                           // F
     {"mlfqs-nice-10", test_mlfqs_nice_10},                         // F
     {"mlfqs-block", test_mlfqs_block},                             // F
+    {"perf-string", test_perf_string},
+    {"perf-switch", test_perf_switch},
 };
 
 static const char *test_name;
@@ -0,0 +1,41 @@
+/* Checks the page fault counters: touching each page of a fresh
+   file mapping takes a major fault, and getrusage() reports the
+   same counts as the inspection interrupt. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+#include <syscall.h>
+
+#define PAGES 4
+
+void test_main(void) {
+    char *actual = (char *)0x10000000;
+    volatile char byte;
+    long long before, after;
+    struct rusage ru;
+    int handle;
+    void *map;
+    size_t i;
+
+    CHECK((handle = open("large.txt")) > 1, "open \"large.txt\"");
+    CHECK((map = mmap(actual, PAGES * 4096, 0, handle, 0)) != MAP_FAILED, "mmap \"large.txt\"");
+
+    before = get_page_fault_cnt(RUSAGE_MAJOR);
+    for (i = 0; i < PAGES; i++)
+        byte = actual[i * 4096];
+    after = get_page_fault_cnt(RUSAGE_MAJOR);
+    (void)byte;
+    if (after - before < PAGES)
+        fail("%lld major faults for %d pages", after - before, PAGES);
+    msg("touching the mapping took a major fault per page");
+
+    CHECK(getrusage(&ru) == 0, "getrusage");
+    if (ru.faults[RUSAGE_MAJOR].cnt != get_page_fault_cnt(RUSAGE_MAJOR))
+        fail("getrusage reports %lld major faults, int 0x45 %lld", ru.faults[RUSAGE_MAJOR].cnt, get_page_fault_cnt(RUSAGE_MAJOR));
+    if (ru.rss < PAGES || ru.rss_peak < ru.rss)
+        fail("getrusage reports %lld pages resident, %lld at peak", ru.rss, ru.rss_peak);
+    msg("getrusage agrees");
+
+    munmap(map);
+    close(handle);
+}
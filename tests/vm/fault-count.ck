@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fault-count) begin
+(fault-count) open "large.txt"
+(fault-count) mmap "large.txt"
+(fault-count) touching the mapping took a major fault per page
+(fault-count) getrusage
+(fault-count) getrusage agrees
+(fault-count) end
+EOF
+pass;
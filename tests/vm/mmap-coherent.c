@@ -0,0 +1,36 @@
+/* Maps a file and, with the mapping still in place, checks that
+   read() sees what is stored through the mapping and that the
+   mapping sees what write() writes, since both go through the
+   same page of the page cache. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/sample.inc"
+#include <string.h>
+#include <syscall.h>
+
+#define ACTUAL ((char *)0x10000000)
+
+void test_main(void) {
+    size_t len = strlen(sample);
+    char buf[1024];
+    int handle;
+
+    CHECK(create("sample.txt", len), "create \"sample.txt\"");
+    CHECK((handle = open("sample.txt")) > 1, "open \"sample.txt\"");
+    CHECK(mmap(ACTUAL, 4096, 1, handle, 0) != MAP_FAILED, "mmap \"sample.txt\"");
+
+    /* Store through the mapping, read through the descriptor. */
+    memcpy(ACTUAL, sample, len);
+    seek(handle, 0);
+    CHECK(read(handle, buf, len) == (int)len, "read \"sample.txt\"");
+    CHECK(!memcmp(buf, sample, len), "read() sees stores to the mapping");
+
+    /* Write through the descriptor, load through the mapping. */
+    seek(handle, 0);
+    CHECK(write(handle, "XYZ", 3) == 3, "write \"sample.txt\"");
+    CHECK(!memcmp(ACTUAL, "XYZ", 3) && !memcmp(ACTUAL + 3, sample + 3, len - 3), "the mapping sees write()");
+
+    munmap(ACTUAL);
+    close(handle);
+}
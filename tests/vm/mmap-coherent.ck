@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-coherent) begin
+(mmap-coherent) create "sample.txt"
+(mmap-coherent) open "sample.txt"
+(mmap-coherent) mmap "sample.txt"
+(mmap-coherent) read "sample.txt"
+(mmap-coherent) read() sees stores to the mapping
+(mmap-coherent) write "sample.txt"
+(mmap-coherent) the mapping sees write()
+(mmap-coherent) end
+EOF
+pass;
@@ -0,0 +1,48 @@
+/* Measures page-fault latency, in TSC cycles per first touch,
+   with 1K, 100K and 1M pages mapped.  The pages are mapped from
+   sample.txt as mappings of 64 pages each, so the larger address
+   spaces also hold thousands of areas, and 256 pages spread
+   evenly across them are then touched.  Mappings are lazy, so
+   only the touched pages ever take memory. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+#include <stdint.h>
+#include <syscall.h>
+
+#define PAGE_SIZE 4096
+#define PAGES_PER_MAP 64
+#define TOUCHES 256
+
+/* Far above the code, data and stack. */
+#define BASE ((char *)0x1000000000)
+
+void test_main(void) {
+    static const size_t mapped[] = {1024, 100 * 1024, 1024 * 1024};
+    size_t i, m, t;
+    int handle;
+
+    CHECK((handle = open("sample.txt")) > 1, "open \"sample.txt\"");
+    for (i = 0; i < sizeof mapped / sizeof *mapped; i++) {
+        size_t maps = mapped[i] / PAGES_PER_MAP;
+        size_t stride = mapped[i] / TOUCHES;
+        volatile char *p;
+        uint64_t start;
+
+        for (m = 0; m < maps; m++) {
+            char *addr = BASE + m * PAGES_PER_MAP * PAGE_SIZE;
+            if (mmap(addr, PAGES_PER_MAP * PAGE_SIZE, 0, handle, 0) != addr)
+                fail("mmap %zu of %zu failed", m, maps);
+        }
+
+        start = rdtsc();
+        for (t = 0; t < TOUCHES; t++) {
+            p = BASE + t * stride * PAGE_SIZE;
+            (void)*p;
+        }
+        msg("perf fault-%zuk %llu", mapped[i] / 1024, (rdtsc() - start) / TOUCHES);
+
+        for (m = 0; m < maps; m++)
+            munmap(BASE + m * PAGES_PER_MAP * PAGE_SIZE);
+    }
+}
@@ -0,0 +1,40 @@
+/* Measures an 8 MB zero-filled array, in TSC cycles per page: the
+   first write to every page, which faults, and a second sweep
+   over all of them, which only misses in the TLB.  Also reports
+   the page faults the first touch took.  With huge pages, most
+   of the array is mapped 2 MB at a time, so both the faults and
+   the TLB misses drop by up to 512 times. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+#include <stdint.h>
+#include <syscall.h>
+
+#define PAGE_SIZE 4096
+#define ARRAY_SIZE (8 * 1024 * 1024)
+#define PAGES (ARRAY_SIZE / PAGE_SIZE)
+
+static char array[ARRAY_SIZE];
+
+/* Writes one byte of every page of the array and reports the
+   cycles per page as METRIC.  A read would only map the zero
+   frame. */
+static void sweep(const char *metric) {
+    volatile char *p;
+    uint64_t start = rdtsc();
+    size_t i;
+
+    for (i = 0; i < PAGES; i++) {
+        p = array + i * PAGE_SIZE;
+        *p = 1;
+    }
+    msg("perf %s %llu", metric, (rdtsc() - start) / PAGES);
+}
+
+void test_main(void) {
+    long long faults = get_page_fault_cnt(RUSAGE_FAULT_KINDS);
+
+    sweep("huge-touch-8m");
+    msg("perf huge-faults-8m %lld", get_page_fault_cnt(RUSAGE_FAULT_KINDS) - faults);
+    sweep("huge-sweep-8m");
+}
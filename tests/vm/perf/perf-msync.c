@@ -0,0 +1,52 @@
+/* Measures writing back a 1 MB file mapping, in TSC cycles per
+   page: msync(MS_SYNC) after every page has been written, and
+   msync(MS_ASYNC), which should return without writing.  Then
+   checks through read() that the MS_SYNC writes reached the
+   file. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+#include <stdint.h>
+#include <syscall.h>
+
+#define PAGE_SIZE 4096
+#define FILE_PAGES 256
+
+/* Far above the code, data and stack. */
+#define BASE ((char *)0x1000000000)
+
+/* Writes TAG to the first byte of every mapped page, syncs with
+   FLAGS, and reports the cycles per page of the msync() call as
+   METRIC. */
+static void dirty_and_sync(char tag, int flags, const char *metric) {
+    uint64_t start;
+    size_t i;
+
+    for (i = 0; i < FILE_PAGES; i++)
+        BASE[i * PAGE_SIZE] = tag;
+    start = rdtsc();
+    if (msync(BASE, FILE_PAGES * PAGE_SIZE, flags) != 0)
+        fail("msync for %s failed", metric);
+    msg("perf %s %llu", metric, (rdtsc() - start) / FILE_PAGES);
+}
+
+void test_main(void) {
+    char byte;
+    int handle;
+    size_t i;
+
+    CHECK(create("sync.dat", FILE_PAGES * PAGE_SIZE), "create \"sync.dat\"");
+    CHECK((handle = open("sync.dat")) > 1, "open \"sync.dat\"");
+    CHECK(mmap(BASE, FILE_PAGES * PAGE_SIZE, 1, handle, 0) == BASE, "mmap \"sync.dat\"");
+
+    dirty_and_sync('s', MS_SYNC, "msync-1m");
+    for (i = 0; i < FILE_PAGES; i++) {
+        seek(handle, i * PAGE_SIZE);
+        if (read(handle, &byte, 1) != 1 || byte != 's')
+            fail("page %zu not written back by MS_SYNC", i);
+    }
+    dirty_and_sync('a', MS_ASYNC, "msync-1m-async");
+
+    munmap(BASE);
+    close(handle);
+}
@@ -0,0 +1,31 @@
+/* Reads every page of a 4 MB array that is never written, which
+   should read as zeros without taking a frame for each page, and
+   then writes one page, which should change only that page. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+#include <syscall.h>
+
+#define PAGE_SIZE 4096
+#define PAGES 1024
+
+static char array[PAGES * PAGE_SIZE];
+
+void test_main(void) {
+    struct rusage before, after;
+    size_t i;
+
+    CHECK(getrusage(&before) == 0, "getrusage");
+    for (i = 0; i < PAGES; i++)
+        if (array[i * PAGE_SIZE] != 0)
+            fail("page %zu reads %d, not 0", i, array[i * PAGE_SIZE]);
+    CHECK(getrusage(&after) == 0, "getrusage");
+    if (after.rss - before.rss >= PAGES / 8)
+        fail("reading %d pages made %lld more resident", PAGES, after.rss - before.rss);
+    msg("reading took no frame per page");
+
+    array[10 * PAGE_SIZE] = 'x';
+    if (array[10 * PAGE_SIZE] != 'x' || array[9 * PAGE_SIZE] != 0 || array[11 * PAGE_SIZE] != 0)
+        fail("writing one page changed its neighbours");
+    msg("writing copied one page");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(zero-read) begin
+(zero-read) getrusage
+(zero-read) getrusage
+(zero-read) reading took no frame per page
+(zero-read) writing copied one page
+(zero-read) end
+EOF
+pass;
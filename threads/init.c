@@ -4,6 +4,7 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "intrinsic.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
@@ -34,10 +35,14 @@
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
+#include "filesys/buffer_cache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
 
+/* CR0, write-protect user pages against the kernel too. */
+#define CR0_WP (1 << 16)
+
 /* Page-map-level-4 with kernel mappings only. */
 uint64_t *base_pml4;
 
@@ -161,6 +166,11 @@ static void paging_init(uint64_t mem_end) {
 
     // reload cr3
     pml4_activate(0);
+    pml4_pcid_init();
+
+    /* Read-only user pages, copy-on-write ones included, must fault
+     * on copy_to_user() as well as on user writes. */
+    lcr0(rcr0() | CR0_WP);
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -210,6 +220,8 @@ static char **parse_options(char **argv) {
 #ifdef FILESYS
         else if (!strcmp(name, "-f"))
             format_filesys = true;
+        else if (!strcmp(name, "-bc-interval"))
+            bcache_flush_interval = atoi(value);
 #endif
         else if (!strcmp(name, "-rs"))
             random_init(atoi(value));
@@ -220,6 +232,26 @@ static char **parse_options(char **argv) {
             user_page_limit = atoi(value);
         else if (!strcmp(name, "-threads-tests"))
             thread_tests = true;
+#endif
+#ifdef VM
+        else if (!strcmp(name, "-evict-fifo"))
+            vm_evict_fifo = true;
+        else if (!strcmp(name, "-fault-around"))
+            vm_fault_around = atoi(value);
+        else if (!strcmp(name, "-stack-limit"))
+            vm_stack_limit = (size_t)atoi(value) * 1024;
+        else if (!strcmp(name, "-wb-interval"))
+            vm_wb_interval = atoi(value);
+        else if (!strcmp(name, "-wb-batch"))
+            vm_wb_batch = atoi(value);
+        else if (!strcmp(name, "-ksm"))
+            vm_ksm_pages = atoi(value);
+        else if (!strcmp(name, "-rss-limit"))
+            vm_rss_limit = atoi(value);
+        else if (!strcmp(name, "-rusage"))
+            vm_rusage_on_exit = true;
+        else if (!strcmp(name, "-no-huge"))
+            vm_huge_pages = false;
 #endif
         else
             PANIC("unknown option `%s' (use -h for help)", name);
@@ -312,8 +344,22 @@ static void usage(void) {
            "  -f                 Format file system disk during startup.\n"
            "  -rs=SEED           Set random number seed to SEED.\n"
            "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+#ifdef FILESYS
+           "  -bc-interval=MS    Write back dirty cached sectors every MS ms (0=off).\n"
+#endif
 #ifdef USERPROG
            "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+           "  -evict-fifo        Evict frames in FIFO order, not by clock.\n"
+           "  -fault-around=N    Map N pages around faults in executables (0=off).\n"
+           "  -stack-limit=KB    Let the user stack grow to at most KB kB.\n"
+           "  -wb-interval=MS    Write back dirty mapped pages every MS ms (0=off).\n"
+           "  -wb-batch=N        Write back at most N pages at a time.\n"
+           "  -ksm=N             Scan N frames for merging every 100 ms (0=off).\n"
+           "  -rss-limit=N       Keep at most N pages of a process resident (0=no limit).\n"
+           "  -rusage            Print each process's page fault counts at exit.\n"
+           "  -no-huge           Map anonymous memory with 4 kB pages only.\n"
 #endif
     );
     power_off();
@@ -338,12 +384,18 @@ void power_off(void) {
 static void print_stats(void) {
     timer_print_stats();
     thread_print_stats();
+    pml4_print_stats();
+    palloc_print_stats();
 #ifdef FILESYS
     disk_print_stats();
+    bcache_print_stats();
 #endif
     console_print_stats();
     kbd_print_stats();
 #ifdef USERPROG
     exception_print_stats();
 #endif
+#ifdef VM
+    vm_print_stats();
+#endif
 }
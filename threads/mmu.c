@@ -1,13 +1,164 @@
 #include "threads/mmu.h"
 #include "intrinsic.h"
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 
+/* Process-context identifiers (PCIDs).
+ *
+ * With CR4.PCIDE set, every TLB entry is tagged with the PCID held
+ * in the low 12 bits of CR3, and a CR3 load with bit 63 set keeps
+ * the entries of all PCIDs instead of flushing the whole TLB.  We
+ * keep a small LRU set of slots, each binding one pml4 to one PCID.
+ * PCID 0 is reserved for base_pml4.  Activating a pml4 that still
+ * owns a slot reloads CR3 without a flush; a pml4 that has to take
+ * over a slot flushes the stale entries of the previous owner.
+ *
+ * Changes to a pml4 that is not loaded cannot be invalidated with
+ * invlpg, so they mark the owning slot stale instead and the next
+ * activation of that pml4 flushes its PCID. */
+#define CPUID_1_ECX_PCID (1 << 17) /* CPUID.01H:ECX, PCID supported. */
+#define CR4_PCIDE (1 << 17)        /* CR4, PCID enable. */
+#define CR3_NOFLUSH (1ULL << 63)   /* CR3, keep TLB entries of the PCID. */
+#define PCID_SLOT_CNT 8            /* PCIDs 1...PCID_SLOT_CNT. */
+
+struct pcid_slot {
+    uint64_t *pml4; /* Owning page map level 4, or NULL. */
+    uint64_t stamp; /* Last activation, for LRU replacement. */
+    bool stale;     /* TLB may hold outdated entries for this PCID. */
+};
+
+static bool pcid_enabled;
+static struct pcid_slot pcid_slots[PCID_SLOT_CNT];
+static uint64_t pcid_clock;
+
+/* Statistics. */
+static long long cr3_load_cnt;   /* # of CR3 loads. */
+static long long cr3_flush_cnt;  /* # of CR3 loads that flushed the TLB. */
+static long long cr3_skip_cnt;   /* # of activations that needed no load. */
+static long long huge_map_cnt;   /* # of huge pages mapped. */
+static long long huge_split_cnt; /* # of huge pages split into page tables. */
+
+/* Huge pages.
+ *
+ * A huge page replaces the page table under its page directory
+ * entry, but that table is not freed: it is kept on a deposit
+ * list, and taken back when the huge page has to be split into
+ * 512 ordinary mappings, as it must before any one page of it can
+ * be changed.  Splitting therefore never allocates, and can happen
+ * anywhere a page table entry is looked up.  The table is empty
+ * while deposited, so the deposit record lives in the table
+ * itself.  The list is changed with interrupts off. */
+struct huge_deposit {
+    struct huge_deposit *next; /* Next deposit. */
+    uint64_t *pde;             /* Huge page directory entry. */
+};
+
+static struct huge_deposit *huge_deposits;
+
+/* Takes the page table deposited for PDE off the deposit list and
+ * returns it.  Must be called with interrupts off. */
+static uint64_t *huge_withdraw(uint64_t *pde) {
+    struct huge_deposit **dp, *d;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+    for (dp = &huge_deposits; (d = *dp) != NULL; dp = &d->next)
+        if (d->pde == pde) {
+            *dp = d->next;
+            return (uint64_t *)d;
+        }
+    NOT_REACHED();
+}
+
+/* Returns the PCID slot owned by PML4, or a null pointer. */
+static struct pcid_slot *pcid_lookup(const uint64_t *pml4) {
+    for (int i = 0; i < PCID_SLOT_CNT; i++)
+        if (pcid_slots[i].pml4 == pml4)
+            return &pcid_slots[i];
+    return NULL;
+}
+
+/* Hands the least recently activated PCID slot over to PML4.
+ * The slot is returned stale, so its first load flushes the
+ * entries left behind by the previous owner. */
+static struct pcid_slot *pcid_assign(uint64_t *pml4) {
+    struct pcid_slot *victim = &pcid_slots[0];
+
+    for (int i = 0; i < PCID_SLOT_CNT; i++) {
+        struct pcid_slot *slot = &pcid_slots[i];
+        if (slot->pml4 == NULL) {
+            victim = slot;
+            break;
+        }
+        if (slot->stamp < victim->stamp)
+            victim = slot;
+    }
+    victim->pml4 = pml4;
+    victim->stale = true;
+    return victim;
+}
+
+/* Returns true if PML4 is the page map loaded in CR3. */
+static bool pml4_is_active(const uint64_t *pml4) { return PTE_ADDR(rcr3()) == vtop(pml4); }
+
+/* Invalidates any TLB entry for VA cached from PML4. */
+static void pml4_invalidate(uint64_t *pml4, const void *va) {
+    if (pml4_is_active(pml4))
+        invlpg((uint64_t)va);
+    else if (pcid_enabled) {
+        struct pcid_slot *slot = pcid_lookup(pml4);
+        if (slot != NULL)
+            slot->stale = true;
+    }
+}
+
+/* Returns the page directory entry for VA in PML4, or a null
+ * pointer if VA has no page directory.  Creates nothing. */
+static uint64_t *pde_lookup(uint64_t *pml4, const uint64_t va) {
+    uint64_t *pdp, *pd;
+
+    if (!(pml4[PML4(va)] & PTE_P))
+        return NULL;
+    pdp = ptov(PTE_ADDR(pml4[PML4(va)]));
+    if (!(pdp[PDPE(va)] & PTE_P))
+        return NULL;
+    pd = ptov(PTE_ADDR(pdp[PDPE(va)]));
+    return &pd[PDX(va)];
+}
+
+/* Returns the page directory entry of the huge page that maps VA
+ * in PML4, or a null pointer if VA is not in a huge page. */
+static uint64_t *pde_huge(uint64_t *pml4, const uint64_t va) {
+    uint64_t *pde = pml4 != NULL ? pde_lookup(pml4, va) : NULL;
+    return pde != NULL && (*pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS) ? pde : NULL;
+}
+
+/* Returns the physical address of the huge page in PDE. */
+static uint64_t pde_huge_addr(uint64_t pde) { return PTE_ADDR(pde) & ~(uint64_t)HPGMASK; }
+
+/* Replaces the huge page of PML4 in PDE, which maps VA, with its
+ * deposited page table, filled in to map the same 512 frames with
+ * the same access, accessed and dirty bits. */
+static void pde_split(uint64_t *pml4, uint64_t *pde, const uint64_t va) {
+    enum intr_level old_level = intr_disable();
+    uint64_t flags = *pde & (PTE_P | PTE_W | PTE_U | PTE_A | PTE_D);
+    uint64_t addr = pde_huge_addr(*pde);
+    uint64_t *pt = huge_withdraw(pde);
+
+    for (unsigned i = 0; i < HPGPAGES; i++)
+        pt[i] = (addr + i * PGSIZE) | flags;
+    *pde = vtop(pt) | PTE_U | PTE_W | PTE_P;
+    pml4_invalidate(pml4, (void *)va);
+    huge_split_cnt++;
+    intr_set_level(old_level);
+}
+
 static uint64_t *pgdir_walk(uint64_t *pdp, const uint64_t va, int create) {
     int idx = PDX(va);
     if (pdp) {
@@ -58,11 +209,15 @@ static uint64_t *pdpe_walk(uint64_t *pdpe, const uint64_t va, int create) {
  * If PML4E does not have a page table for VADDR, behavior depends
  * on CREATE.  If CREATE is true, then a new page table is
  * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
+ * pointer is returned.
+ * A huge page that maps VADDR is split first, so that the entry
+ * returned is VADDR's own. */
 uint64_t *pml4e_walk(uint64_t *pml4e, const uint64_t va, int create) {
-    uint64_t *pte = NULL;
+    uint64_t *pte = NULL, *pde;
     int idx = PML4(va);
     int allocated = 0;
+    if ((pde = pde_huge(pml4e, va)) != NULL)
+        pde_split(pml4e, pde, va);
     if (pml4e) {
         uint64_t *pdpe = (uint64_t *)pml4e[idx];
         if (!((uint64_t)pdpe & PTE_P)) {
@@ -111,7 +266,8 @@ static bool pt_for_each(uint64_t *pt, pte_for_each_func *func, void *aux, unsign
 static bool pgdir_for_each(uint64_t *pdp, pte_for_each_func *func, void *aux, unsigned pml4_index, unsigned pdp_index) {
     for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
         uint64_t *pte = ptov((uint64_t *)pdp[i]);
-        if (((uint64_t)pte) & PTE_P)
+        /* Huge pages have no page table entries to visit. */
+        if ((((uint64_t)pte) & PTE_P) && !(((uint64_t)pte) & PTE_PS))
             if (!pt_for_each((uint64_t *)PTE_ADDR(pte), func, aux, pml4_index, pdp_index, i))
                 return false;
     }
@@ -151,8 +307,17 @@ static void pt_destroy(uint64_t *pt) {
 static void pgdir_destroy(uint64_t *pdp) {
     for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
         uint64_t *pte = ptov((uint64_t *)pdp[i]);
-        if (((uint64_t)pte) & PTE_P)
-            pt_destroy(PTE_ADDR(pte));
+        if (((uint64_t)pte) & PTE_P) {
+            /* A huge page's frames belong to whoever mapped them;
+             * only its deposited page table is ours to free. */
+            if (((uint64_t)pte) & PTE_PS) {
+                enum intr_level old_level = intr_disable();
+                uint64_t *pt = huge_withdraw(&pdp[i]);
+                intr_set_level(old_level);
+                palloc_free_page(pt);
+            } else
+                pt_destroy(PTE_ADDR(pte));
+        }
     }
     palloc_free_page((void *)pdp);
 }
@@ -171,6 +336,12 @@ void pml4_destroy(uint64_t *pml4) {
     if (pml4 == NULL)
         return;
     ASSERT(pml4 != base_pml4);
+    ASSERT(!pml4_is_active(pml4));
+
+    /* Give up our PCID.  The next owner flushes its entries. */
+    struct pcid_slot *slot = pcid_lookup(pml4);
+    if (slot != NULL)
+        slot->pml4 = NULL;
 
     /* if PML4 (vaddr) >= 1, it's kernel space by define. */
     uint64_t *pdpe = ptov((uint64_t *)pml4[0]);
@@ -179,9 +350,69 @@ void pml4_destroy(uint64_t *pml4) {
     palloc_free_page((void *)pml4);
 }
 
+/* Enables PCID tagging of the TLB if the CPU supports it.
+ * Must be called once base_pml4 is loaded with PCID 0. */
+void pml4_pcid_init(void) {
+    uint32_t ecx;
+
+    cpuid(1, NULL, NULL, &ecx, NULL);
+    if ((ecx & CPUID_1_ECX_PCID) == 0)
+        return;
+
+    /* CR4.PCIDE may only be set while CR3 selects PCID 0. */
+    ASSERT((rcr3() & PGMASK) == 0);
+    lcr4(rcr4() | CR4_PCIDE);
+    pcid_enabled = true;
+}
+
 /* Loads page directory PD into the CPU's page directory base
- * register. */
-void pml4_activate(uint64_t *pml4) { lcr3(vtop(pml4 ? pml4 : base_pml4)); }
+ * register.  The load is skipped if PML4 is already active, and
+ * does not flush the TLB if PML4 still owns an up-to-date PCID. */
+void pml4_activate(uint64_t *pml4) {
+    enum intr_level old_level = intr_disable();
+    uint64_t cr3;
+
+    if (pml4 == NULL)
+        pml4 = base_pml4;
+
+    if (!pcid_enabled || pml4 == base_pml4) {
+        /* Without PCIDs only the loaded pml4 has entries in the TLB,
+         * and those are kept up to date with invlpg.  The kernel
+         * mappings of PCID 0 never change after boot. */
+        cr3 = vtop(pml4) | (pcid_enabled ? CR3_NOFLUSH : 0);
+        if (pml4_is_active(pml4) && (rcr3() & PGMASK) == 0)
+            cr3_skip_cnt++;
+        else {
+            cr3_load_cnt++;
+            lcr3(cr3);
+        }
+    } else {
+        struct pcid_slot *slot = pcid_lookup(pml4);
+        if (slot == NULL)
+            slot = pcid_assign(pml4);
+        slot->stamp = ++pcid_clock;
+
+        cr3 = vtop(pml4) | (uint64_t)(slot - pcid_slots + 1);
+        if (!slot->stale && rcr3() == cr3)
+            cr3_skip_cnt++;
+        else {
+            cr3_load_cnt++;
+            if (slot->stale)
+                cr3_flush_cnt++;
+            else
+                cr3 |= CR3_NOFLUSH;
+            slot->stale = false;
+            lcr3(cr3);
+        }
+    }
+    intr_set_level(old_level);
+}
+
+/* Prints address space switch statistics. */
+void pml4_print_stats(void) {
+    printf("MMU: %lld CR3 loads, %lld TLB flushes, %lld skipped, PCID %s\n", cr3_load_cnt, cr3_flush_cnt, cr3_skip_cnt, pcid_enabled ? "on" : "off");
+    printf("MMU: %lld huge pages mapped, %lld split\n", huge_map_cnt, huge_split_cnt);
+}
 
 /* Looks up the physical address that corresponds to user virtual
  * address UADDR in pml4.  Returns the kernel virtual address
@@ -190,6 +421,10 @@ void pml4_activate(uint64_t *pml4) { lcr3(vtop(pml4 ? pml4 : base_pml4)); }
 void *pml4_get_page(uint64_t *pml4, const void *uaddr) {
     ASSERT(is_user_vaddr(uaddr));
 
+    uint64_t *pde = pde_huge(pml4, (uint64_t)uaddr);
+    if (pde != NULL)
+        return ptov(pde_huge_addr(*pde)) + ((uint64_t)uaddr & HPGMASK);
+
     uint64_t *pte = pml4e_walk(pml4, (uint64_t)uaddr, 0);
 
     if (pte && (*pte & PTE_P))
@@ -213,11 +448,52 @@ bool pml4_set_page(uint64_t *pml4, void *upage, void *kpage, bool rw) {
 
     uint64_t *pte = pml4e_walk(pml4, (uint64_t)upage, 1);
 
-    if (pte)
+    if (pte) {
+        bool was_present = (*pte & PTE_P) != 0;
         *pte = vtop(kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+        if (was_present)
+            pml4_invalidate(pml4, upage);
+    }
     return pte != NULL;
 }
 
+/* Maps the HPGSIZE bytes of user virtual memory at UPAGE in PML4
+ * to the physically contiguous frames at kernel virtual address
+ * KPAGE with a single huge page.  Both must be HPGSIZE-aligned,
+ * and no page in the range may be mapped yet.  The mapping is
+ * writable if WRITABLE is true.  Returns true if successful,
+ * false if memory allocation failed or a page was mapped. */
+bool pml4_set_huge_page(uint64_t *pml4, void *upage, void *kpage, bool rw) {
+    struct huge_deposit *d;
+    uint64_t *pt;
+
+    ASSERT(((uint64_t)upage & HPGMASK) == 0);
+    ASSERT((vtop(kpage) & HPGMASK) == 0);
+    ASSERT(is_user_vaddr(upage));
+    ASSERT(pml4 != base_pml4);
+
+    pt = pml4e_walk(pml4, (uint64_t)upage, 1);
+    if (pt == NULL)
+        return false;
+    for (unsigned i = 0; i < HPGPAGES; i++)
+        if (pt[i] & PTE_P)
+            return false;
+
+    enum intr_level old_level = intr_disable();
+    d = (struct huge_deposit *)pt;
+    d->pde = pde_lookup(pml4, (uint64_t)upage);
+    d->next = huge_deposits;
+    huge_deposits = d;
+    *d->pde = vtop(kpage) | PTE_PS | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+    pml4_invalidate(pml4, upage);
+    huge_map_cnt++;
+    intr_set_level(old_level);
+    return true;
+}
+
+/* Returns true if UPAGE is mapped in PML4 by a huge page. */
+bool pml4_is_huge(uint64_t *pml4, const void *upage) { return pde_huge(pml4, (uint64_t)upage) != NULL; }
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
  * bits in the page table entry are preserved.
@@ -231,8 +507,7 @@ void pml4_clear_page(uint64_t *pml4, void *upage) {
 
     if (pte != NULL && (*pte & PTE_P) != 0) {
         *pte &= ~PTE_P;
-        if (rcr3() == vtop(pml4))
-            invlpg((uint64_t)upage);
+        pml4_invalidate(pml4, upage);
     }
 }
 
@@ -241,6 +516,10 @@ void pml4_clear_page(uint64_t *pml4, void *upage) {
  * installed.
  * Returns false if PML4 contains no PTE for VPAGE. */
 bool pml4_is_dirty(uint64_t *pml4, const void *vpage) {
+    uint64_t *pde = pde_huge(pml4, (uint64_t)vpage);
+    if (pde != NULL)
+        return (*pde & PTE_D) != 0;
+
     uint64_t *pte = pml4e_walk(pml4, (uint64_t)vpage, false);
     return pte != NULL && (*pte & PTE_D) != 0;
 }
@@ -253,18 +532,23 @@ void pml4_set_dirty(uint64_t *pml4, const void *vpage, bool dirty) {
         if (dirty)
             *pte |= PTE_D;
         else
-            *pte &= ~(uint32_t)PTE_D;
+            *pte &= ~(uint64_t)PTE_D;
 
-        if (rcr3() == vtop(pml4))
-            invlpg((uint64_t)vpage);
+        pml4_invalidate(pml4, vpage);
     }
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PML4 has been
  * accessed recently, that is, between the time the PTE was
  * installed and the last time it was cleared.  Returns false if
- * PML4 contains no PTE for VPAGE. */
+ * PML4 contains no PTE for VPAGE.
+ * The dirty and accessed bits of a page in a huge page are those
+ * of the whole huge page. */
 bool pml4_is_accessed(uint64_t *pml4, const void *vpage) {
+    uint64_t *pde = pde_huge(pml4, (uint64_t)vpage);
+    if (pde != NULL)
+        return (*pde & PTE_A) != 0;
+
     uint64_t *pte = pml4e_walk(pml4, (uint64_t)vpage, false);
     return pte != NULL && (*pte & PTE_A) != 0;
 }
@@ -272,14 +556,15 @@ bool pml4_is_accessed(uint64_t *pml4, const void *vpage) {
 /* Sets the accessed bit to ACCESSED in the PTE for virtual page
    VPAGE in PD. */
 void pml4_set_accessed(uint64_t *pml4, const void *vpage, bool accessed) {
-    uint64_t *pte = pml4e_walk(pml4, (uint64_t)vpage, false);
+    uint64_t *pte = pde_huge(pml4, (uint64_t)vpage);
+    if (pte == NULL)
+        pte = pml4e_walk(pml4, (uint64_t)vpage, false);
     if (pte) {
         if (accessed)
             *pte |= PTE_A;
         else
-            *pte &= ~(uint32_t)PTE_A;
+            *pte &= ~(uint64_t)PTE_A;
 
-        if (rcr3() == vtop(pml4))
-            invlpg((uint64_t)vpage);
+        pml4_invalidate(pml4, vpage);
     }
 }
@@ -1,5 +1,6 @@
 #include "threads/palloc.h"
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -26,11 +27,30 @@
    half to the user pool.  That should be huge overkill for the
    kernel pool, but that's just fine for demonstration purposes. */
 
+/* Pre-zeroed pages.
+
+   Zeroing a page on every PAL_ZERO request puts a 4 kB memset on
+   the critical path of thread creation, page table growth, stack
+   setup and anonymous page faults.  Instead, each pool keeps a
+   small cache of pages that the idle thread zeroes while the CPU
+   would otherwise halt, and single-page PAL_ZERO requests are
+   served from it first.  Cached pages stay marked as used in the
+   pool's bitmap; they are handed back when the pool runs dry.
+
+   The cache is manipulated with interrupts disabled rather than
+   under the pool lock, so that the idle thread never blocks. */
+#define ZERO_CACHE_PAGES 32
+
 /* A memory pool. */
 struct pool {
     struct lock lock;        /* Mutual exclusion. */
     struct bitmap *used_map; /* Bitmap of free pages. */
     uint8_t *base;           /* Base of pool. */
+
+    void *zeroed[ZERO_CACHE_PAGES]; /* Pre-zeroed pages. */
+    size_t zeroed_cnt;              /* Number of pages in ZEROED. */
+    long long zero_hits;            /* PAL_ZERO requests served from ZEROED. */
+    long long zero_misses;          /* PAL_ZERO requests zeroed inline. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -41,6 +61,8 @@ size_t user_page_limit = SIZE_MAX;
 static void init_pool(struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool(const struct pool *, void *page);
+static void *zero_cache_pop(struct pool *);
+static bool zero_cache_drain(struct pool *);
 
 /* multiboot info */
 struct multiboot_info {
@@ -252,8 +274,19 @@ uint64_t palloc_init(void) {
 void *palloc_get_multiple(enum palloc_flags flags, size_t page_cnt) {
     struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
 
+    /* A single zeroed page comes from the pre-zeroed cache. */
+    if (page_cnt == 1 && (flags & PAL_ZERO)) {
+        void *page = zero_cache_pop(pool);
+        if (page != NULL) {
+            pool->zero_hits++;
+            return page;
+        }
+    }
+
     lock_acquire(&pool->lock);
     size_t page_idx = bitmap_scan_and_flip(pool->used_map, 0, page_cnt, false);
+    if (page_idx == BITMAP_ERROR && zero_cache_drain(pool))
+        page_idx = bitmap_scan_and_flip(pool->used_map, 0, page_cnt, false);
     lock_release(&pool->lock);
     void *pages;
 
@@ -263,8 +296,10 @@ void *palloc_get_multiple(enum palloc_flags flags, size_t page_cnt) {
         pages = NULL;
 
     if (pages) {
-        if (flags & PAL_ZERO)
+        if (flags & PAL_ZERO) {
             memset(pages, 0, PGSIZE * page_cnt);
+            pool->zero_misses++;
+        }
     } else {
         if (flags & PAL_ASSERT)
             PANIC("palloc_get: out of pages");
@@ -282,6 +317,44 @@ void *palloc_get_multiple(enum palloc_flags flags, size_t page_cnt) {
    FLAGS, in which case the kernel panics. */
 void *palloc_get_page(enum palloc_flags flags) { return palloc_get_multiple(flags, 1); }
 
+/* Obtains PAGE_CNT contiguous free pages, as palloc_get_multiple()
+   does, whose physical address is a multiple of PAGE_CNT pages.
+   PAGE_CNT must be a power of 2.  Only aligned runs are looked
+   at, so a fragmented pool fails where palloc_get_multiple()
+   might not. */
+void *palloc_get_aligned(enum palloc_flags flags, size_t page_cnt) {
+    struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+    size_t bit_cnt = bitmap_size(pool->used_map);
+    size_t align_ofs, page_idx = BITMAP_ERROR;
+    void *pages = NULL;
+
+    ASSERT(page_cnt > 0 && (page_cnt & (page_cnt - 1)) == 0);
+
+    /* Index of the first page whose physical address is aligned. */
+    align_ofs = (page_cnt - pg_no(vtop(pool->base)) % page_cnt) % page_cnt;
+
+    lock_acquire(&pool->lock);
+    for (int tries = 0; tries < 2 && page_idx == BITMAP_ERROR; tries++) {
+        if (tries > 0 && !zero_cache_drain(pool))
+            break;
+        for (size_t i = align_ofs; i + page_cnt <= bit_cnt; i += page_cnt)
+            if (bitmap_none(pool->used_map, i, page_cnt)) {
+                bitmap_set_multiple(pool->used_map, i, page_cnt, true);
+                page_idx = i;
+                break;
+            }
+    }
+    lock_release(&pool->lock);
+
+    if (page_idx != BITMAP_ERROR) {
+        pages = pool->base + PGSIZE * page_idx;
+        if (flags & PAL_ZERO)
+            memset(pages, 0, PGSIZE * page_cnt);
+    } else if (flags & PAL_ASSERT)
+        PANIC("palloc_get: out of pages");
+    return pages;
+}
+
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void palloc_free_multiple(void *pages, size_t page_cnt) {
     struct pool *pool;
@@ -310,6 +383,79 @@ void palloc_free_multiple(void *pages, size_t page_cnt) {
 /* Frees the page at PAGE. */
 void palloc_free_page(void *page) { palloc_free_multiple(page, 1); }
 
+/* Takes a page from POOL's pre-zeroed cache.
+   Returns a null pointer if the cache is empty. */
+static void *zero_cache_pop(struct pool *pool) {
+    void *page = NULL;
+    enum intr_level old_level = intr_disable();
+    if (pool->zeroed_cnt > 0)
+        page = pool->zeroed[--pool->zeroed_cnt];
+    intr_set_level(old_level);
+    return page;
+}
+
+/* Returns every page in POOL's pre-zeroed cache to POOL's bitmap.
+   Called with POOL's lock held when the pool runs out of pages.
+   Returns true if any page was released. */
+static bool zero_cache_drain(struct pool *pool) {
+    bool released = false;
+    void *page;
+
+    ASSERT(lock_held_by_current_thread(&pool->lock));
+    while ((page = zero_cache_pop(pool)) != NULL) {
+        bitmap_reset(pool->used_map, pg_no(page) - pg_no(pool->base));
+        released = true;
+    }
+    return released;
+}
+
+/* Zeroes one free page into the pre-zeroed cache of the first pool
+   whose cache is not full.  Called from the idle thread, so it
+   never blocks: a busy pool lock is simply skipped.  Returns true
+   if a page was added, false if there is nothing to do right now. */
+bool palloc_prezero_page(void) {
+    struct pool *pools[] = {&user_pool, &kernel_pool};
+
+    for (size_t i = 0; i < sizeof pools / sizeof *pools; i++) {
+        struct pool *pool = pools[i];
+        size_t page_idx;
+
+        if (pool->zeroed_cnt >= ZERO_CACHE_PAGES || !lock_try_acquire(&pool->lock))
+            continue;
+        page_idx = bitmap_scan_and_flip(pool->used_map, 0, 1, false);
+        lock_release(&pool->lock);
+        if (page_idx == BITMAP_ERROR)
+            continue;
+
+        void *page = pool->base + PGSIZE * page_idx;
+        memset(page, 0, PGSIZE);
+
+        enum intr_level old_level = intr_disable();
+        bool stored = pool->zeroed_cnt < ZERO_CACHE_PAGES;
+        if (stored)
+            pool->zeroed[pool->zeroed_cnt++] = page;
+        intr_set_level(old_level);
+
+        if (!stored)
+            palloc_free_page(page);
+        return stored;
+    }
+    return false;
+}
+
+/* Returns the first page of the user pool and stores the number
+   of pages it spans in *PAGE_CNT, so that tables can be indexed
+   by user frame number. */
+void *palloc_user_pool(size_t *page_cnt) {
+    *page_cnt = bitmap_size(user_pool.used_map);
+    return user_pool.base;
+}
+
+/* Prints pre-zeroed page cache statistics. */
+void palloc_print_stats(void) {
+    printf("Palloc: kernel pool %lld zeroed hits, %lld misses; user pool %lld zeroed hits, %lld misses\n", kernel_pool.zero_hits, kernel_pool.zero_misses, user_pool.zero_hits, user_pool.zero_misses);
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void init_pool(struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
     /* We'll put the pool's used_map at its base.
@@ -365,6 +365,16 @@ static void idle(void *idle_started_ UNUSED) {
         intr_disable();
         thread_block();
 
+        /* Nothing else wants the CPU, so zero pages for later
+           PAL_ZERO allocations, one page at a time so that a thread
+           made ready by an interrupt gets the CPU promptly. */
+        intr_enable();
+        while (list_empty(&ready_list) && palloc_prezero_page())
+            continue;
+        intr_disable();
+        if (!list_empty(&ready_list))
+            continue;
+
         /* Re-enable interrupts and wait for the next one.
 
            The `sti' instruction disables interrupts until the
@@ -425,8 +435,10 @@ static struct thread *next_thread_to_run(void) {
         return list_entry(list_pop_front(&ready_list), struct thread, elem);
 }
 
-/* Use iretq to launch the thread */
-void do_iret(struct intr_frame *tf) {
+/* Use iretq to launch the thread.  Marked used because thread_launch()
+   calls it from inline assembly, which link-time optimization cannot
+   see. */
+__attribute__((used)) void do_iret(struct intr_frame *tf) {
     __asm __volatile("movq %0, %%rsp\n"
                      "movq 0(%%rsp),%%r15\n"
                      "movq 8(%%rsp),%%r14\n"
@@ -3,6 +3,7 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "userprog/gdt.h"
+#include "userprog/uaccess.h"
 #include <inttypes.h>
 #include <stdio.h>
 
@@ -137,6 +138,11 @@ static void page_fault(struct intr_frame *f) {
     /* Count page faults. */
     page_fault_cnt++;
 
+    /* A bad user address hit by copy_from_user() and friends is an
+       error for the system call, not a kernel bug. */
+    if (!user && uaccess_fixup(f))
+        return;
+
     /* If the fault is true fault, show info and exit. */
     printf("Page fault at %p: %s error %s page in %s context.\n", fault_addr, not_present ? "not present" : "rights violation", write ? "writing" : "reading", user ? "user" : "kernel");
     kill(f);
@@ -68,12 +68,30 @@ static void initd(void *f_name) {
     NOT_REACHED();
 }
 
+/* What process_fork() hands to __do_fork(). */
+struct fork_args {
+    struct thread *parent;
+    struct intr_frame *if_; /* Parent's user context. */
+    struct semaphore done;  /* Up'd once the child is set up or has failed. */
+    bool success;
+};
+
 /* Clones the current process as `name`. Returns the new process's thread id, or
- * TID_ERROR if the thread cannot be created. */
+ * TID_ERROR if the thread cannot be created.  Does not return until
+ * the child has copied the parent's resources. */
 // Q. 왜 thread_create를 하는걸까?
-tid_t process_fork(const char *name, struct intr_frame *if_ UNUSED) {
+tid_t process_fork(const char *name, struct intr_frame *if_) {
+    struct fork_args args = {.parent = thread_current(), .if_ = if_, .success = false};
+    tid_t tid;
+
+    sema_init(&args.done, 0);
+
     /* Clone current thread to new thread.*/
-    return thread_create(name, PRI_DEFAULT, __do_fork, thread_current());
+    tid = thread_create(name, PRI_DEFAULT, __do_fork, &args);
+    if (tid == TID_ERROR)
+        return TID_ERROR;
+    sema_down(&args.done);
+    return args.success ? tid : TID_ERROR;
 }
 
 #ifndef VM
@@ -86,23 +104,32 @@ static bool duplicate_pte(uint64_t *pte, void *va, void *aux) {
     void *newpage;
     bool writable;
 
-    /* 1. TODO: If the parent_page is kernel page, then return immediately. */
+    /* 1. If the parent_page is kernel page, then return immediately. */
+    if (is_kernel_vaddr(va))
+        return true;
 
     /* 2. Resolve VA from the parent's page map level 4. */
     // virtual addr -> (by pml4 : 페이지 테이블) -> physical addr
     parent_page = pml4_get_page(parent->pml4, va);
 
-    /* 3. TODO: Allocate new PAL_USER page for the child and set result to
-     *    TODO: NEWPAGE. */
+    /* 3. Allocate new PAL_USER page for the child and set result to
+     *    NEWPAGE. */
+    newpage = palloc_get_page(PAL_USER);
+    if (newpage == NULL)
+        return false;
 
-    /* 4. TODO: Duplicate parent's page to the new page and
-     *    TODO: check whether parent's page is writable or not (set WRITABLE
-     *    TODO: according to the result). */
+    /* 4. Duplicate parent's page to the new page and
+     *    check whether parent's page is writable or not (set WRITABLE
+     *    according to the result). */
+    memcpy(newpage, parent_page, PGSIZE);
+    writable = is_writable(pte);
 
     /* 5. Add new page to child's page table at address VA with WRITABLE
      *    permission. */
     if (!pml4_set_page(current->pml4, va, newpage, writable)) { // Q. 내부 구현
-        /* 6. TODO: if fail to insert page, do error handling. */
+        /* 6. if fail to insert page, do error handling. */
+        palloc_free_page(newpage);
+        return false;
     }
     return true;
 }
@@ -114,14 +141,16 @@ static bool duplicate_pte(uint64_t *pte, void *va, void *aux) {
  *       this function. */
 static void __do_fork(void *aux) {
     struct intr_frame if_;
-    struct thread *parent = (struct thread *)aux;
+    struct fork_args *args = aux;
+    struct thread *parent = args->parent;
     struct thread *current = thread_current();
-    /* TODO: somehow pass the parent_if. (i.e. process_fork()'s if_) */
-    struct intr_frame *parent_if;
-    bool succ = true;
+    struct intr_frame *parent_if = args->if_;
+    int fd;
 
-    /* 1. Read the cpu context to local stack. */
+    /* 1. Read the cpu context to local stack.  The child sees fork()
+     *    return 0. */
     memcpy(&if_, parent_if, sizeof(struct intr_frame));
+    if_.R.rax = 0;
 
     /* 2. Duplicate PT */
     current->pml4 = pml4_create();
@@ -138,18 +167,21 @@ static void __do_fork(void *aux) {
         goto error;
 #endif
 
-    /* TODO: Your code goes here.
-     * TODO: Hint) To duplicate the file object, use `file_duplicate`
-     * TODO:       in include/filesys/file.h. Note that parent should not return
-     * TODO:       from the fork() until this function successfully duplicates
-     * TODO:       the resources of parent.*/
+    /* 3. Duplicate the open files.  The parent is blocked in
+     *    process_fork() until we are done. */
+    for (fd = 0; fd <= FD_MAX; fd++)
+        if (parent->fdt[fd] != NULL && (current->fdt[fd] = file_duplicate(parent->fdt[fd])) == NULL)
+            goto error;
+    current->fdt_last_idx = parent->fdt_last_idx;
 
     process_init();
+    args->success = true;
+    sema_up(&args->done);
 
     /* Finally, switch to the newly created process. */
-    if (succ)
-        do_iret(&if_);
+    do_iret(&if_);
 error:
+    sema_up(&args->done);
     thread_exit();
 }
 
@@ -225,6 +257,9 @@ int process_exec(void *fname_n_args) {
 
     /* We first kill the current context */
     process_cleanup();
+#ifdef VM
+    supplemental_page_table_init(&thread_current()->spt);
+#endif
 
     /* Parsing f_name & arguments */
     arg_parsing(fname_n_args, &file_name, parsed_arr, &argc);
@@ -318,8 +353,11 @@ static void process_cleanup(void) {
 /* Sets up the CPU for running user code in the nest thread.
  * This function is called on every context switch. */
 void process_activate(struct thread *next) {
-    /* Activate thread's page tables. */
-    pml4_activate(next->pml4);
+    /* Activate thread's page tables.  Kernel threads only touch the
+     * kernel mappings, which every pml4 shares, so they keep running
+     * in whatever address space is already loaded. */
+    if (next->pml4 != NULL)
+        pml4_activate(next->pml4);
 
     /* Set thread's kernel stack for use in processing interrupts. */
     tss_update(next);
@@ -475,6 +513,9 @@ static bool load(const char *file_name, struct intr_frame *if_) {
      * TODO: Implement argument passing (see project2/argument_passing.html). */
 
     success = true;
+#ifdef VM
+    vm_exec_cnt++;
+#endif
 
 done:
     /* We arrive here whether the load is successful or not. */
@@ -624,12 +665,6 @@ static bool install_page(void *upage, void *kpage, bool writable) {
  * If you want to implement the function for only project 2, implement it on the
  * upper block. */
 
-static bool lazy_load_segment(struct page *page, void *aux) {
-    /* TODO: Load the segment from the file */
-    /* TODO: This called when the first page fault occurs on address VA. */
-    /* TODO: VA is available when calling this function. */
-}
-
 /* Loads a segment starting at offset OFS in FILE at address
  * UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
  * memory are initialized, as follows:
@@ -642,44 +677,46 @@ static bool lazy_load_segment(struct page *page, void *aux) {
  * The pages initialized by this function must be writable by the
  * user process if WRITABLE is true, read-only otherwise.
  *
+ * Nothing is read here: the segment becomes one virtual memory
+ * area, and each page is read in by vma_load_page() when it is
+ * first touched.
+ *
  * Return true if successful, false if a memory allocation error
- * or disk read error occurs. */
+ * occurs or the segment overlaps another. */
 static bool load_segment(struct file *file, off_t ofs, uint8_t *upage, uint32_t read_bytes, uint32_t zero_bytes, bool writable) {
+    struct file *segment_file;
+
     ASSERT((read_bytes + zero_bytes) % PGSIZE == 0);
     ASSERT(pg_ofs(upage) == 0);
     ASSERT(ofs % PGSIZE == 0);
 
-    while (read_bytes > 0 || zero_bytes > 0) {
-        /* Do calculate how to fill this page.
-         * We will read PAGE_READ_BYTES bytes from FILE
-         * and zero the final PAGE_ZERO_BYTES bytes. */
-        size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-        size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-        /* TODO: Set up aux to pass information to the lazy_load_segment. */
-        void *aux = NULL;
-        if (!vm_alloc_page_with_initializer(VM_ANON, upage, writable, lazy_load_segment, aux))
-            return false;
-
-        /* Advance. */
-        read_bytes -= page_read_bytes;
-        zero_bytes -= page_zero_bytes;
-        upage += PGSIZE;
+    /* load() closes FILE once the headers are read, so the area
+     * keeps its own.  Its pages may be shared with other processes
+     * running the program, so the file must not change under them. */
+    segment_file = file_reopen(file);
+    if (segment_file == NULL)
+        return false;
+    file_deny_write(segment_file);
+    if (vma_create(&thread_current()->spt, upage, read_bytes + zero_bytes, writable ? VMA_DATA : VMA_CODE, VM_ANON, writable, segment_file, ofs, read_bytes) == NULL) {
+        file_close(segment_file);
+        return false;
     }
     return true;
 }
 
 /* Create a PAGE of stack at the USER_STACK. Return true on success. */
 static bool setup_stack(struct intr_frame *if_) {
-    bool success = false;
+    struct supplemental_page_table *spt = &thread_current()->spt;
     void *stack_bottom = (void *)(((uint8_t *)USER_STACK) - PGSIZE);
 
-    /* TODO: Map the stack on stack_bottom and claim the page immediately.
-     * TODO: If success, set the rsp accordingly.
-     * TODO: You should mark the page is stack. */
-    /* TODO: Your code goes here */
+    /* The stack is an area of its own, which vm_try_handle_fault()
+     * grows down on demand.  Its first page is claimed now. */
+    spt->stack = vma_create(spt, stack_bottom, PGSIZE, VMA_STACK, VM_ANON, true, NULL, 0, 0);
+    if (spt->stack == NULL || !vm_claim_page(stack_bottom))
+        return false;
 
-    return success;
+    if_->rsp = USER_STACK;
+    return true;
 }
 #endif /* VM */
 
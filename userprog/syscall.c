@@ -6,9 +6,15 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/loader.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 #include "userprog/gdt.h"
 #include "userprog/process.h"
+#include "userprog/uaccess.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -40,9 +46,20 @@ void syscall_init(void) {
     write_msr(MSR_SYSCALL_MASK, FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
 }
 
-int validate_ptr(uint64_t vaddr) { // user pool 내부에 있고, process page 내에 있는지 확인
-    uint64_t *pml4 = thread_current()->pml4;
-    return pml4_get_page(pml4, vaddr) != NULL;
+/* Copies the user string USTR into a newly allocated page and
+ * returns it.  Terminates the process if USTR is not a valid user
+ * string that fits in a page.  The caller frees the page. */
+static char *copy_in_string(const char *ustr) {
+    char *kstr = palloc_get_page(0);
+    if (kstr == NULL)
+        exit(-1);
+
+    int64_t len = strncpy_from_user(kstr, ustr, PGSIZE);
+    if (len < 0 || len == PGSIZE) {
+        palloc_free_page(kstr);
+        exit(-1);
+    }
+    return kstr;
 }
 
 void get_argv(struct intr_frame *ifp, uint64_t *argv, int argc) {
@@ -67,7 +84,8 @@ struct syscall_action {
 
 static const struct syscall_action syscall_actions[] = {
     {SYS_HALT, 0}, {SYS_EXIT, 1},     {SYS_EXEC, 1}, {SYS_FORK, 1},  {SYS_WAIT, 1}, {SYS_CREATE, 2}, {SYS_REMOVE, 1},
-    {SYS_OPEN, 1}, {SYS_FILESIZE, 1}, {SYS_READ, 3}, {SYS_WRITE, 3}, {SYS_SEEK, 2}, {SYS_TELL, 1},   {SYS_CLOSE, 1} // 끝
+    {SYS_OPEN, 1}, {SYS_FILESIZE, 1}, {SYS_READ, 3}, {SYS_WRITE, 3}, {SYS_SEEK, 2}, {SYS_TELL, 1},   {SYS_CLOSE, 1},
+    {SYS_MMAP, 5}, {SYS_MUNMAP, 1}, [SYS_MADVISE] = {SYS_MADVISE, 3}, {SYS_MSYNC, 3}, {SYS_SET_RSS_LIMIT, 1}, {SYS_GETRUSAGE, 1} // 끝
 };
 
 /* The main system call interface */
@@ -77,6 +95,10 @@ void syscall_handler(struct intr_frame *ifp) {
     dev_printf("\n\nsystem call! [%d]\n", sys_call_num);
     const struct syscall_action *action = &syscall_actions[sys_call_num];
     get_argv(ifp, argv, action->argc);
+#ifdef VM
+    /* Faults on user memory during the call may need to grow the stack. */
+    thread_current()->user_rsp = ifp->rsp;
+#endif
 
     switch (sys_call_num) {
     case SYS_HALT:
@@ -88,7 +110,7 @@ void syscall_handler(struct intr_frame *ifp) {
         exit(exit_status);
         break;
     case SYS_FORK:
-        // ifp->R.rax = fork();
+        ifp->R.rax = fork((const char *)argv[0], ifp);
         break;
     case SYS_EXEC:
         char *file_name = argv[0];
@@ -128,6 +150,26 @@ void syscall_handler(struct intr_frame *ifp) {
     case SYS_CLOSE:
         close(argv[0]);
         break;
+#ifdef VM
+    case SYS_MMAP:
+        ifp->R.rax = (uint64_t)mmap((void *)argv[0], argv[1], argv[2], argv[3], argv[4]);
+        break;
+    case SYS_MUNMAP:
+        munmap((void *)argv[0]);
+        break;
+    case SYS_MADVISE:
+        ifp->R.rax = madvise((void *)argv[0], argv[1], argv[2]);
+        break;
+    case SYS_MSYNC:
+        ifp->R.rax = msync((void *)argv[0], argv[1], argv[2]);
+        break;
+    case SYS_SET_RSS_LIMIT:
+        ifp->R.rax = set_rss_limit(argv[0]);
+        break;
+    case SYS_GETRUSAGE:
+        ifp->R.rax = getrusage((struct rusage *)argv[0]);
+        break;
+#endif
     default:
         dev_printf("Unknown system call: %d\n", sys_call_num);
         thread_exit();
@@ -142,30 +184,47 @@ void halt() { power_off(); }
 void exit(int exit_code) {
     struct thread *curr = thread_current();
     printf("%s: exit(%d)\n", curr->name, exit_code);
+#ifdef VM
+    vm_print_rusage(curr->name);
+#endif
     thread_exit();
 }
 
+int fork(const char *thread_name, struct intr_frame *ifp) {
+    char *kname = copy_in_string(thread_name);
+    tid_t tid = process_fork(kname, ifp);
+    palloc_free_page(kname);
+    return tid;
+}
+
 int wait(pid_t tid) { return process_wait(tid); }
 
-int exec(const char *file) { return process_create_initd(file); }
+int exec(const char *file) {
+    char *kfile = copy_in_string(file);
+    int tid = process_create_initd(kfile);
+    palloc_free_page(kfile);
+    return tid;
+}
 
 // ============== FILE SYSTEM ==============
 int create(const char *file, unsigned initial_size) {
-    if (file == NULL || !(validate_ptr(file)))
-        exit(-1);
-    else if (strlen(file) == 0)
-        return 0;
-
-    return filesys_create(file, initial_size);
+    char *kfile = copy_in_string(file);
+    int success = strlen(kfile) > 0 && filesys_create(kfile, initial_size);
+    palloc_free_page(kfile);
+    return success;
 }
 
-int remove(const char *file) { return filesys_remove(file); }
+int remove(const char *file) {
+    char *kfile = copy_in_string(file);
+    int success = filesys_remove(kfile);
+    palloc_free_page(kfile);
+    return success;
+}
 
 int open(const char *file) {
-    if (file == NULL || !validate_ptr(file))
-        exit(-1);
-
-    struct file *fp = filesys_open(file);
+    char *kfile = copy_in_string(file);
+    struct file *fp = filesys_open(kfile);
+    palloc_free_page(kfile);
     if (fp == NULL)
         return -1;
 
@@ -177,42 +236,82 @@ int filesize(int fd) {
     return file_length(fp);
 }
 
+/* User buffers are moved through a kernel bounce page, one page at
+ * a time, so that the file system never touches user memory. */
 int read(int fd, void *buffer, unsigned length) {
-    if (!validate_ptr(buffer) || fd == STDOUT_FILENO)
+    if (fd == STDOUT_FILENO)
         exit(-1);
 
+    struct file *fp = NULL;
     if (fd < 0 || fd > FD_MAX)
         return -1;
-    else if (fd == STDIN_FILENO)
-        return input_getc();
-
-    struct file *fp = process_get_file(fd);
+    else if (fd != STDIN_FILENO && (fp = process_get_file(fd)) == NULL)
+        return -1;
 
-    if (fp == NULL)
+    uint8_t *bounce = palloc_get_page(0);
+    if (bounce == NULL)
         return -1;
 
-    return file_read(fp, buffer, length);
+    unsigned bytes_read = 0;
+    while (bytes_read < length) {
+        unsigned chunk = length - bytes_read < PGSIZE ? length - bytes_read : PGSIZE;
+        unsigned n;
+
+        if (fp == NULL) {
+            for (n = 0; n < chunk; n++)
+                bounce[n] = input_getc();
+        } else
+            n = file_read(fp, bounce, chunk);
+
+        if (copy_to_user((uint8_t *)buffer + bytes_read, bounce, n) != 0) {
+            palloc_free_page(bounce);
+            exit(-1);
+        }
+        bytes_read += n;
+        if (n < chunk)
+            break;
+    }
+    palloc_free_page(bounce);
+    return bytes_read;
 }
 
 int write(int fd, const void *buffer, unsigned length) {
-    if (!validate_ptr(buffer) || fd == STDIN_FILENO)
+    if (fd == STDIN_FILENO)
         exit(-1);
 
+    struct file *fp = NULL;
     if (fd < 0 || fd > FD_MAX)
         return -1;
-    else if (fd == STDOUT_FILENO) {
-        putbuf(buffer, length);
-        return 0;
-    }
-
-    struct file *fp = process_get_file(fd);
+    else if (fd != STDOUT_FILENO && (fp = process_get_file(fd)) == NULL)
+        return -1;
 
-    if (fp == NULL)
+    uint8_t *bounce = palloc_get_page(0);
+    if (bounce == NULL)
         return -1;
 
-    return file_write(fp, buffer, length);
+    unsigned bytes_written = 0;
+    while (bytes_written < length) {
+        unsigned chunk = length - bytes_written < PGSIZE ? length - bytes_written : PGSIZE;
+        unsigned n;
+
+        if (copy_from_user(bounce, (const uint8_t *)buffer + bytes_written, chunk) != 0) {
+            palloc_free_page(bounce);
+            exit(-1);
+        }
+
+        if (fp == NULL) {
+            putbuf((const char *)bounce, chunk);
+            n = chunk;
+        } else
+            n = file_write(fp, bounce, chunk);
+
+        bytes_written += n;
+        if (n < chunk)
+            break;
+    }
+    palloc_free_page(bounce);
+    return bytes_written;
 }
-
 void seek(int fd, unsigned position) {
     struct file *fp = process_get_file(fd);
     file_seek(fp, position);
@@ -229,4 +328,31 @@ void close(int fd) {
         exit(-1);
     }
     process_close_file(fd);
-}
\ No newline at end of file
+}
+
+#ifdef VM
+void *mmap(void *addr, size_t length, int writable, int fd, off_t offset) {
+    struct file *fp;
+
+    if (fd == STDIN_FILENO || fd == STDOUT_FILENO || (fp = process_get_file(fd)) == NULL)
+        return NULL;
+    return do_mmap(addr, length, writable, fp, offset);
+}
+
+void munmap(void *addr) { do_munmap(addr); }
+
+int madvise(void *addr, size_t length, int advice) { return vm_madvise(addr, length, advice); }
+
+int msync(void *addr, size_t length, int flags) { return vm_msync(addr, length, flags); }
+
+int set_rss_limit(size_t pages) { return vm_set_rss_limit(pages); }
+
+int getrusage(struct rusage *usage) {
+    struct rusage ru;
+
+    vm_getrusage(&ru);
+    if (copy_to_user(usage, &ru, sizeof ru) != 0)
+        exit(-1);
+    return 0;
+}
+#endif
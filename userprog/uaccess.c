@@ -0,0 +1,83 @@
+/* uaccess.c: Copying data between kernel and user memory.
+ *
+ * System calls must never dereference a user pointer directly:
+ * the page may be unmapped, or the pointer may reach into kernel
+ * memory.  Instead of probing every page up front, these
+ * primitives only check that the range lies in user space and then
+ * copy straight away.  A fault on a bad user page is caught by
+ * page_fault(), which finds the faulting instruction in the
+ * exception table built by uaccess-copy.S and resumes at its fixup. */
+
+#include "userprog/uaccess.h"
+#include "threads/interrupt.h"
+#include "threads/vaddr.h"
+#include <debug.h>
+
+size_t __copy_user(void *dst, const void *src, size_t size);
+int64_t __strncpy_user(char *dst, const char *src, size_t size);
+
+/* An exception table entry, emitted by uaccess-copy.S. */
+struct exception_entry {
+    uint64_t insn;  /* Address of an instruction that may fault. */
+    uint64_t fixup; /* Where to resume if it does. */
+};
+
+/* Bounds of the exception table, provided by the linker script. */
+extern const struct exception_entry __start_ex_table[], __stop_ex_table[];
+
+/* Returns true if [UADDR, UADDR + SIZE) lies entirely in user
+ * space. */
+static bool user_range_ok(const void *uaddr, size_t size) {
+    uint64_t start = (uint64_t)uaddr;
+    return start + size >= start && start + size <= KERN_BASE;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel buffer DST.
+ * Returns the number of bytes that could not be copied, so 0
+ * means success. */
+size_t copy_from_user(void *dst, const void *usrc, size_t size) {
+    if (!user_range_ok(usrc, size))
+        return size;
+    return __copy_user(dst, usrc, size);
+}
+
+/* Copies SIZE bytes from kernel buffer SRC to user address UDST.
+ * Returns the number of bytes that could not be copied, so 0
+ * means success. */
+size_t copy_to_user(void *udst, const void *src, size_t size) {
+    if (!user_range_ok(udst, size))
+        return size;
+    return __copy_user(udst, src, size);
+}
+
+/* Copies the null-terminated user string USRC into DST, which has
+ * room for SIZE bytes.  Returns the length of the string, or SIZE
+ * if it does not fit (DST is then not null-terminated), or -1 if
+ * USRC is not a valid user string, as when it runs up to
+ * KERN_BASE without a null terminator. */
+int64_t strncpy_from_user(char *dst, const char *usrc, size_t size) {
+    uint64_t start = (uint64_t)usrc;
+    int64_t len;
+
+    if (start >= KERN_BASE)
+        return -1;
+    /* Never let the copy loop walk into kernel space. */
+    if (size <= KERN_BASE - start)
+        return __strncpy_user(dst, usrc, size);
+    len = __strncpy_user(dst, usrc, KERN_BASE - start);
+    return len == (int64_t)(KERN_BASE - start) ? -1 : len;
+}
+
+/* Called by the page fault handler for a fault in kernel mode.
+ * If the faulting instruction belongs to one of the copy routines
+ * above, redirects F to its fixup and returns true. */
+bool uaccess_fixup(struct intr_frame *f) {
+    const struct exception_entry *e;
+
+    for (e = __start_ex_table; e < __stop_ex_table; e++)
+        if (e->insn == f->rip) {
+            f->rip = e->fixup;
+            return true;
+        }
+    return false;
+}
@@ -1,6 +1,7 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "devices/disk.h"
+#include "threads/mmu.h"
 #include "vm/vm.h"
 
 /* DO NOT MODIFY BELOW LINE */
@@ -19,23 +20,55 @@ static const struct page_operations anon_ops = {
 
 /* Initialize the data for anonymous pages */
 void vm_anon_init(void) {
-    /* TODO: Set up the swap_disk. */
-    swap_disk = NULL;
+    swap_disk = disk_get(1, 1);
+    swap_init(swap_disk);
 }
 
 /* Initialize the file mapping */
-bool anon_initializer(struct page *page, enum vm_type type, void *kva) {
+bool anon_initializer(struct page *page, enum vm_type type UNUSED, void *kva UNUSED) {
     /* Set up the handler */
     page->operations = &anon_ops;
 
     struct anon_page *anon_page = &page->anon;
+    anon_page->slot = SWAP_SLOT_NONE;
+    return true;
 }
 
-/* Swap in the page by read contents from the swap disk. */
-static bool anon_swap_in(struct page *page, void *kva) { struct anon_page *anon_page = &page->anon; }
+/* Swap in the page by read contents from the swap disk.  A page
+ * that was dropped rather than swapped is loaded from its area
+ * again. */
+static bool anon_swap_in(struct page *page, void *kva) {
+    struct anon_page *anon_page = &page->anon;
+
+    if (anon_page->slot == SWAP_SLOT_NONE)
+        return page->vma != NULL && vma_load_page(page, NULL);
+
+    swap_in_page(anon_page->slot, kva);
+    swap_free(&page->owner->spt, anon_page->slot);
+    anon_page->slot = SWAP_SLOT_NONE;
 
-/* Swap out the page by writing contents to the swap disk. */
-static bool anon_swap_out(struct page *page) { struct anon_page *anon_page = &page->anon; }
+    /* With its slot gone, the page must be written again if it is
+     * evicted, even if it is not modified. */
+    pml4_set_dirty(page->owner->pml4, page->va, true);
+    return true;
+}
+
+/* Swap out the page by writing contents to the swap disk.  A page
+ * that still holds what its area would load is simply dropped. */
+static bool anon_swap_out(struct page *page) {
+    struct anon_page *anon_page = &page->anon;
+
+    if (page->vma != NULL && !pml4_is_dirty(page->owner->pml4, page->va))
+        return true;
+    anon_page->slot = swap_out_page(&page->owner->spt, page->frame->kva);
+    return anon_page->slot != SWAP_SLOT_NONE;
+}
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
-static void anon_destroy(struct page *page) { struct anon_page *anon_page = &page->anon; }
+static void anon_destroy(struct page *page) {
+    struct anon_page *anon_page = &page->anon;
+
+    if (anon_page->slot != SWAP_SLOT_NONE)
+        swap_free(&page->owner->spt, anon_page->slot);
+    vm_free_frame(page);
+}
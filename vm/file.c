@@ -1,6 +1,12 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include "filesys/inode.h"
+#include "threads/mmu.h"
+#include "threads/vaddr.h"
+#include <mman.h>
+#include <round.h>
+#include <string.h>
 
 static bool file_backed_swap_in(struct page *page, void *kva);
 static bool file_backed_swap_out(struct page *page);
@@ -18,24 +24,108 @@ static const struct page_operations file_ops = {
 void vm_file_init(void) {}
 
 /* Initialize the file backed page */
-bool file_backed_initializer(struct page *page, enum vm_type type, void *kva) {
+bool file_backed_initializer(struct page *page, enum vm_type type UNUSED, void *kva UNUSED) {
+    struct vma *vma = page->vma;
+    size_t ofs = (uint8_t *)page->va - (uint8_t *)vma_start(vma);
+
     /* Set up the handler */
     page->operations = &file_ops;
 
     struct file_page *file_page = &page->file;
+    file_page->file = vma->file;
+    file_page->offset = vma->offset + ofs;
+    file_page->read_bytes = ofs < vma->file_bytes ? vma->file_bytes - ofs : 0;
+    if (file_page->read_bytes > PGSIZE)
+        file_page->read_bytes = PGSIZE;
+
+    /* A page that holds all of the file it covers, up to the end of
+     * the file, maps the page cache.  One that the end of the
+     * mapping cuts short keeps a copy of its own, since the cache
+     * would show it the rest of the file. */
+    file_page->cached = file_page->read_bytes == PGSIZE || (file_page->read_bytes > 0 && file_page->offset + (off_t)file_page->read_bytes >= file_length(vma->file));
+    return true;
+}
+
+/* Writes PAGE, which must have a frame, back to its file if the
+ * process modified it.  The dirty bit is cleared first, so that a
+ * write to the page while it is on its way out marks it dirty
+ * again rather than being lost.
+ *
+ * The write goes to the inode directly.  A page that maps the page
+ * cache is the cache's copy already; one with a copy of its own
+ * brings the cache's copy, if there is one, up to date.  The
+ * caller holds the frame lock, which protects the cache. */
+bool file_backed_write_back(struct page *page) {
+    struct file_page *file_page = &page->file;
+    struct inode *inode = file_get_inode(file_page->file);
+    uint64_t *pml4 = page->owner->pml4;
+    struct frame *cached;
+
+    if (!pml4_is_dirty(pml4, page->va))
+        return true;
+    pml4_set_dirty(pml4, page->va, false);
+    if (inode_write_at(inode, page->frame->kva, file_page->read_bytes, file_page->offset) != (off_t)file_page->read_bytes) {
+        pml4_set_dirty(pml4, page->va, true);
+        return false;
+    }
+    if (!file_page->cached && (cached = pcache_find(inode_get_inumber(inode), file_page->offset)) != NULL)
+        memcpy(cached->kva, page->frame->kva, file_page->read_bytes);
+    return true;
 }
 
 /* Swap in the page by read contents from the file. */
-static bool file_backed_swap_in(struct page *page, void *kva) { struct file_page *file_page UNUSED = &page->file; }
+static bool file_backed_swap_in(struct page *page, void *kva) {
+    struct file_page *file_page = &page->file;
+
+    if (file_read_at(file_page->file, kva, file_page->read_bytes, file_page->offset) != (off_t)file_page->read_bytes)
+        return false;
+    memset((uint8_t *)kva + file_page->read_bytes, 0, PGSIZE - file_page->read_bytes);
+    return true;
+}
 
 /* Swap out the page by writeback contents to the file. */
-static bool file_backed_swap_out(struct page *page) { struct file_page *file_page UNUSED = &page->file; }
+static bool file_backed_swap_out(struct page *page) { return file_backed_write_back(page); }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
-static void file_backed_destroy(struct page *page) { struct file_page *file_page UNUSED = &page->file; }
+static void file_backed_destroy(struct page *page) {
+    if (page->frame != NULL)
+        file_backed_write_back(page);
+    vm_free_frame(page);
+}
 
 /* Do the mmap */
-void *do_mmap(void *addr, size_t length, int writable, struct file *file, off_t offset) {}
+void *do_mmap(void *addr, size_t length, int writable, struct file *file, off_t offset) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    bool populate = (writable & MAP_POPULATE) != 0;
+    struct file *mapped;
+    off_t file_len;
+    size_t file_bytes = 0;
+
+    if (addr == NULL || pg_ofs(addr) != 0 || length == 0 || length > KERN_BASE || offset < 0 || offset % PGSIZE != 0)
+        return NULL;
+
+    file_len = file_length(file);
+    if (offset < file_len)
+        file_bytes = (size_t)(file_len - offset) < length ? (size_t)(file_len - offset) : length;
+
+    /* The mapping outlives the descriptor, so it gets its own file. */
+    mapped = file_reopen(file);
+    if (mapped == NULL)
+        return NULL;
+    if (vma_create(spt, addr, ROUND_UP(length, PGSIZE), VMA_MMAP, VM_FILE, (writable & ~MAP_POPULATE) != 0, mapped, offset, file_bytes) == NULL) {
+        file_close(mapped);
+        return NULL;
+    }
+    if (populate)
+        vm_madvise(addr, length, MADV_WILLNEED);
+    return addr;
+}
 
 /* Do the munmap */
-void do_munmap(void *addr) {}
+void do_munmap(void *addr) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    struct vma *vma = vma_find(spt, addr);
+
+    if (vma != NULL && vma->kind == VMA_MMAP && vma_start(vma) == addr)
+        vma_destroy(spt, vma);
+}
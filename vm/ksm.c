@@ -0,0 +1,69 @@
+/* ksm.c: Index of anonymous frames by content, for same-page
+ * merging.
+ *
+ * The merging scanner in vm.c checksums anonymous frames as it
+ * passes them.  A frame whose checksum held steady between two
+ * passes is entered here, and the next frame found with the same
+ * checksum is compared against it byte for byte and, if they
+ * match, merged into it.  An entry can go stale when its frame is
+ * written; the full compare catches that, and the scanner then
+ * replaces it.
+ *
+ * The index is protected by the frame lock, which callers hold. */
+
+#include "vm/ksm.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+#include <debug.h>
+#include <hash.h>
+
+static struct hash frames;
+
+static uint64_t ksm_hash(const struct hash_elem *e, void *aux UNUSED);
+static bool ksm_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED);
+
+/* Sets up the index. */
+void ksm_init(void) { hash_init(&frames, ksm_hash, ksm_less, NULL); }
+
+/* Returns a checksum of the page at KVA.  It works a word at a
+ * time, which is several times faster than hash_bytes() on a whole
+ * page, and the scanner only needs it to find candidates. */
+uint64_t ksm_checksum(const void *kva) {
+    const uint64_t *w = kva;
+    uint64_t sum = 0xcbf29ce484222325ULL;
+    size_t i;
+
+    for (i = 0; i < PGSIZE / sizeof *w; i++)
+        sum = (sum ^ w[i]) * 0x100000001b3ULL;
+    return sum;
+}
+
+/* Enters FRAME, whose checksum field must be up to date, into the
+ * index and returns a null pointer, unless a frame with the same
+ * checksum is there already, in which case that frame is
+ * returned and FRAME is not entered. */
+struct frame *ksm_insert(struct frame *frame) {
+    struct hash_elem *e;
+
+    ASSERT(!(frame->flags & FRAME_KSM));
+
+    e = hash_insert(&frames, &frame->ksm_elem);
+    if (e != NULL)
+        return hash_entry(e, struct frame, ksm_elem);
+    frame->flags |= FRAME_KSM;
+    return NULL;
+}
+
+/* Drops FRAME from the index, if it is there. */
+void ksm_remove(struct frame *frame) {
+    if (!(frame->flags & FRAME_KSM))
+        return;
+    hash_delete(&frames, &frame->ksm_elem);
+    frame->flags &= ~FRAME_KSM;
+}
+
+/* Returns a hash value for frame E. */
+static uint64_t ksm_hash(const struct hash_elem *e, void *aux UNUSED) { return hash_entry(e, struct frame, ksm_elem)->checksum; }
+
+/* Returns true if frame A's checksum is less than frame B's. */
+static bool ksm_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED) { return hash_entry(a, struct frame, ksm_elem)->checksum < hash_entry(b, struct frame, ksm_elem)->checksum; }
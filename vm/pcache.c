@@ -0,0 +1,201 @@
+/* pcache.c: Page cache, the one copy in memory of each page of a
+ * file that has been read, written or mapped.
+ *
+ * A cached page is a frame of the frame table, found here by the
+ * sector of its file's inode and its offset in the file, which is
+ * a multiple of the page size.  It holds the file's bytes, and
+ * zeros past the end of the file.  read() copies out of it,
+ * write() copies into it as well as to the disk, and every mmap()
+ * of the file maps it directly, so that all of them see the same
+ * bytes without copying them between one another.
+ *
+ * Writes through a mapping only reach the disk when the mapping's
+ * page is written back, as before, but a frame that no page maps
+ * is always clean.  Eviction treats such a frame like any other,
+ * giving it a second chance if it was read or written since the
+ * clock hand last passed, and simply drops it from here when it
+ * is taken.  Pages stay cached when their file is closed, and are
+ * dropped when it is deleted, before its sectors can be reused.
+ *
+ * The index is protected by the frame lock, which callers of
+ * pcache_find(), pcache_insert() and pcache_remove() hold. */
+
+#include "vm/pcache.h"
+#include "filesys/inode.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+#include <debug.h>
+#include <hash.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+
+static struct hash frames;
+
+/* Until vm_init() runs, which is after the file system has been
+ * set up, reads and writes go straight to the inode. */
+static bool pcache_ready;
+
+/* Statistics. */
+static long long insert_cnt; /* # of pages cached. */
+static long long hit_cnt;    /* # of lookups that found their page. */
+
+static uint64_t pcache_hash(const struct hash_elem *e, void *aux UNUSED);
+static bool pcache_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED);
+
+/* Sets up the cache. */
+void pcache_init(void) {
+    hash_init(&frames, pcache_hash, pcache_less, NULL);
+    pcache_ready = true;
+}
+
+/* Prints cache statistics. */
+void pcache_print_stats(void) { printf("Page cache: %zu pages cached, %lld cached in all, %lld lookups hit\n", hash_size(&frames), insert_cnt, hit_cnt); }
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at OFFSET,
+ * copying each page that is cached out of the cache.  FILL says
+ * what becomes of the others: if true, they are read into the
+ * cache first, as for read(); if false, they are read straight
+ * into BUFFER, for the kernel's one-time reads of executables and
+ * file pages that keep copies of their own.  Returns the number
+ * of bytes read, which is less than SIZE if end of file is
+ * reached. */
+off_t pcache_read(struct inode *inode, void *buffer_, off_t size, off_t offset, bool fill) {
+    uint8_t *buffer = buffer_;
+    off_t length = inode_length(inode);
+    off_t bytes_read = 0;
+
+    if (!pcache_ready)
+        return inode_read_at(inode, buffer, size, offset);
+
+    while (size > 0 && offset < length) {
+        off_t page_ofs = offset % PGSIZE;
+        off_t chunk = PGSIZE - page_ofs;
+        struct frame *frame;
+
+        if (chunk > size)
+            chunk = size;
+        if (chunk > length - offset)
+            chunk = length - offset;
+
+        frame = vm_cache_get(inode, offset - page_ofs, fill);
+        if (frame != NULL) {
+            memcpy(buffer + bytes_read, (uint8_t *)frame->kva + page_ofs, chunk);
+            vm_cache_put(frame);
+        } else if (inode_read_at(inode, buffer + bytes_read, chunk, offset) != chunk)
+            break;
+
+        size -= chunk;
+        offset += chunk;
+        bytes_read += chunk;
+    }
+    return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+ * and copies them into the pages of the cache they fall in, if
+ * those are cached.  Pages not cached are not read in: a write
+ * does not say the bytes around it will be wanted.  Returns the
+ * number of bytes written, as inode_write_at() does. */
+off_t pcache_write(struct inode *inode, const void *buffer_, off_t size, off_t offset) {
+    const uint8_t *buffer = buffer_;
+    off_t length = inode_length(inode);
+    off_t written = inode_write_at(inode, buffer, size, offset);
+    off_t done, chunk;
+
+    if (!pcache_ready)
+        return written;
+
+    /* A write that leaves a gap after the old end of file makes the
+     * gap part of the file, as zeros.  The cached page holding the
+     * old end has zeros there too, unless a mapping that shares it
+     * stored into its tail. */
+    if (written > 0 && offset > length && length % PGSIZE != 0) {
+        struct frame *frame = vm_cache_get(inode, length - length % PGSIZE, false);
+
+        if (frame != NULL) {
+            off_t end = offset < ROUND_UP(length, PGSIZE) ? offset : ROUND_UP(length, PGSIZE);
+
+            memset((uint8_t *)frame->kva + length % PGSIZE, 0, end - length);
+            vm_cache_put(frame);
+        }
+    }
+
+    for (done = 0; done < written; done += chunk) {
+        off_t page_ofs = (offset + done) % PGSIZE;
+        struct frame *frame;
+
+        chunk = PGSIZE - page_ofs < written - done ? PGSIZE - page_ofs : written - done;
+        frame = vm_cache_get(inode, offset + done - page_ofs, false);
+        if (frame != NULL) {
+            memcpy((uint8_t *)frame->kva + page_ofs, buffer + done, chunk);
+            vm_cache_put(frame);
+        }
+    }
+    return written;
+}
+
+/* Drops the cached pages of INODE, which is being deleted. */
+void pcache_drop(struct inode *inode) {
+    if (pcache_ready)
+        vm_cache_drop(inode);
+}
+
+/* Returns the frame caching the page at OFFSET in the file whose
+ * inode is at SECTOR, or a null pointer. */
+struct frame *pcache_find(disk_sector_t sector, off_t offset) {
+    struct frame key;
+    struct hash_elem *e;
+
+    key.cache_sector = sector;
+    key.cache_offset = offset;
+    e = hash_find(&frames, &key.cache_elem);
+    if (e == NULL)
+        return NULL;
+    hit_cnt++;
+    return hash_entry(e, struct frame, cache_elem);
+}
+
+/* Caches FRAME, which must hold the page at OFFSET in the file
+ * whose inode is at SECTOR, and returns a null pointer, unless
+ * that page is cached already, in which case the frame caching it
+ * is returned and FRAME is not cached. */
+struct frame *pcache_insert(struct frame *frame, disk_sector_t sector, off_t offset) {
+    struct hash_elem *e;
+
+    ASSERT(!(frame->flags & FRAME_CACHE));
+    ASSERT(offset % PGSIZE == 0);
+
+    frame->cache_sector = sector;
+    frame->cache_offset = offset;
+    e = hash_insert(&frames, &frame->cache_elem);
+    if (e != NULL)
+        return hash_entry(e, struct frame, cache_elem);
+    frame->flags |= FRAME_CACHE;
+    insert_cnt++;
+    return NULL;
+}
+
+/* Drops FRAME from the cache, if it is there. */
+void pcache_remove(struct frame *frame) {
+    if (!(frame->flags & FRAME_CACHE))
+        return;
+    hash_delete(&frames, &frame->cache_elem);
+    frame->flags &= ~(FRAME_CACHE | FRAME_REFERENCED);
+}
+
+/* Returns a hash value for frame E. */
+static uint64_t pcache_hash(const struct hash_elem *e, void *aux UNUSED) {
+    const struct frame *f = hash_entry(e, struct frame, cache_elem);
+    return hash_int(f->cache_sector) ^ hash_int(f->cache_offset / PGSIZE);
+}
+
+/* Returns true if frame A's page precedes frame B's. */
+static bool pcache_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED) {
+    const struct frame *a = hash_entry(a_, struct frame, cache_elem);
+    const struct frame *b = hash_entry(b_, struct frame, cache_elem);
+
+    if (a->cache_sector != b->cache_sector)
+        return a->cache_sector < b->cache_sector;
+    return a->cache_offset < b->cache_offset;
+}
@@ -0,0 +1,329 @@
+/* swap.c: Page slots on the swap disk.
+ *
+ * The swap disk is divided into page-sized slots, tracked in a
+ * bitmap.  Slots are handed out next-fit from a cursor, so pages
+ * evicted one after another land in adjacent slots.  Between
+ * swap_plug() and swap_unplug() writes are held back and those
+ * adjacent pages go out together as a single multi-sector disk
+ * command, which costs little more than writing one of them.
+ *
+ * In front of the disk sits zswap (zswap.c), a compressed cache
+ * keyed by slot: a page is still given a slot when it is swapped
+ * out, but usually lands in the cache, and reaches its slot on
+ * disk only if the cache has to make room.
+ *
+ * A swap-in from disk reads, with the same command, up to
+ * SWAP_CLUSTER - 1 slots that follow its own: pages evicted
+ * together land in adjacent slots and tend to be wanted together.
+ * Those pages go into the swap cache, a few kernel pages keyed by
+ * slot, so the faults that want them next copy them from memory.
+ * Only slots whose contents are known to be on disk are read
+ * ahead: a slot is "unwritten" from the time it is handed out
+ * until its page reaches the disk, which for a page held by zswap
+ * may be never.
+ *
+ * Swap-outs only happen during eviction, which the frame lock
+ * serializes, so the pending batch needs no lock of its own;
+ * SWAP_LOCK covers the slot bitmaps, the swap cache and the
+ * per-process counts, which swap-ins and process exit also
+ * change. */
+
+#include "vm/swap.h"
+#include "devices/disk.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+#include "vm/zswap.h"
+#include "intrinsic.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Sectors in one slot. */
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Pages in the swap cache. */
+#define SWAP_CACHE_PAGES 32
+
+static struct disk *swap_disk;
+static struct bitmap *used_slots;      /* Slots in use, or NULL if no swap. */
+static struct bitmap *unwritten_slots; /* Slots in use not yet on disk. */
+static size_t next_slot;               /* Where the next allocation looks first. */
+static struct lock swap_lock;
+
+/* A page of the swap cache. */
+struct swap_cache_entry {
+    size_t slot;  /* Slot whose page KVA holds, or SWAP_SLOT_NONE. */
+    bool loading; /* Still being read from disk? */
+    void *kva;    /* The page. */
+};
+
+static struct swap_cache_entry swap_cache[SWAP_CACHE_PAGES];
+static size_t cache_hand; /* Entry cache_alloc() looks at first. */
+
+/* Pages waiting to be written while plugged: BATCH_CNT pages
+ * bound for the slots starting at BATCH_FIRST. */
+static bool plugged;
+static size_t batch_first;
+static size_t batch_cnt;
+static const void *batch_kva[SWAP_CLUSTER];
+
+/* Statistics. */
+static long long out_cnt;       /* # of pages written. */
+static long long write_cnt;     /* # of disk commands the writes took. */
+static long long in_cnt;        /* # of swap-ins read from disk. */
+static long long in_cycles;     /* TSC cycles those reads took. */
+static long long ahead_cnt;     /* # of pages read ahead with them. */
+static long long cache_hit_cnt; /* # of swap-ins from the swap cache. */
+static long long zin_cnt;       /* # of pages swapped in from zswap. */
+static long long zin_cycles;    /* TSC cycles those took. */
+
+/* Sets up swap on DISK, which may be null if there is none, in
+ * which case every swap-out fails. */
+void swap_init(struct disk *disk) {
+    uint8_t *pages;
+    size_t i;
+
+    lock_init(&swap_lock);
+    swap_disk = disk;
+    if (disk == NULL)
+        return;
+    used_slots = bitmap_create(disk_size(disk) / SECTORS_PER_SLOT);
+    unwritten_slots = bitmap_create(disk_size(disk) / SECTORS_PER_SLOT);
+    if (used_slots == NULL || unwritten_slots == NULL)
+        PANIC("swap bitmap creation failed--swap disk is too large");
+
+    pages = palloc_get_multiple(PAL_ASSERT, SWAP_CACHE_PAGES);
+    for (i = 0; i < SWAP_CACHE_PAGES; i++) {
+        swap_cache[i].slot = SWAP_SLOT_NONE;
+        swap_cache[i].kva = pages + i * PGSIZE;
+    }
+    zswap_init();
+}
+
+/* Returns the swap cache entry for SLOT, or a null pointer.  The
+ * caller must hold SWAP_LOCK. */
+static struct swap_cache_entry *cache_find(size_t slot) {
+    ASSERT(lock_held_by_current_thread(&swap_lock));
+
+    for (size_t i = 0; i < SWAP_CACHE_PAGES; i++)
+        if (swap_cache[i].slot == slot)
+            return &swap_cache[i];
+    return NULL;
+}
+
+/* Returns a swap cache entry to read a page into, dropping the
+ * page it held, or a null pointer if every entry is being read.
+ * Entries are reused in turn, oldest first.  The caller must hold
+ * SWAP_LOCK. */
+static struct swap_cache_entry *cache_alloc(void) {
+    ASSERT(lock_held_by_current_thread(&swap_lock));
+
+    for (size_t i = 0; i < SWAP_CACHE_PAGES; i++) {
+        struct swap_cache_entry *e = &swap_cache[cache_hand];
+
+        cache_hand = (cache_hand + 1) % SWAP_CACHE_PAGES;
+        if (!e->loading)
+            return e;
+    }
+    return NULL;
+}
+
+/* Marks the CNT slots starting at FIRST as written to disk. */
+static void slots_written(size_t first, size_t cnt) {
+    lock_acquire(&swap_lock);
+    bitmap_set_multiple(unwritten_slots, first, cnt, false);
+    lock_release(&swap_lock);
+}
+
+/* Writes out the pending batch, if any. */
+static void batch_flush(void) {
+    const void *sectors[SWAP_CLUSTER * SECTORS_PER_SLOT];
+    size_t i;
+
+    if (batch_cnt == 0)
+        return;
+    for (i = 0; i < batch_cnt * SECTORS_PER_SLOT; i++)
+        sectors[i] = (const uint8_t *)batch_kva[i / SECTORS_PER_SLOT] + i % SECTORS_PER_SLOT * DISK_SECTOR_SIZE;
+    disk_writev(swap_disk, batch_first * SECTORS_PER_SLOT, sectors, batch_cnt * SECTORS_PER_SLOT);
+    slots_written(batch_first, batch_cnt);
+    write_cnt++;
+    batch_cnt = 0;
+}
+
+/* Writes the page at KVA to a free slot on behalf of the process
+ * whose table is SPT and returns the slot, or SWAP_SLOT_NONE if
+ * swap is full.  The page goes to zswap if it compresses well
+ * enough.  Otherwise, while plugged, the write to disk may be
+ * deferred until swap_unplug(); KVA must stay untouched until
+ * then. */
+size_t swap_out_page(struct supplemental_page_table *spt, const void *kva) {
+    size_t slot;
+
+    if (used_slots == NULL)
+        return SWAP_SLOT_NONE;
+
+    lock_acquire(&swap_lock);
+    slot = bitmap_scan_and_flip(used_slots, next_slot, 1, false);
+    if (slot == BITMAP_ERROR)
+        slot = bitmap_scan_and_flip(used_slots, 0, 1, false);
+    if (slot != BITMAP_ERROR) {
+        bitmap_mark(unwritten_slots, slot);
+        next_slot = slot + 1;
+        if (++spt->swap_cnt > spt->swap_peak)
+            spt->swap_peak = spt->swap_cnt;
+    }
+    lock_release(&swap_lock);
+    if (slot == BITMAP_ERROR)
+        return SWAP_SLOT_NONE;
+    if (zswap_store(slot, kva))
+        return slot;
+
+    out_cnt++;
+    if (batch_cnt > 0 && (batch_cnt == SWAP_CLUSTER || slot != batch_first + batch_cnt))
+        batch_flush();
+    if (batch_cnt == 0)
+        batch_first = slot;
+    batch_kva[batch_cnt++] = kva;
+    if (!plugged)
+        batch_flush();
+    return slot;
+}
+
+/* Writes the page at KVA to SLOT on disk at once, bypassing zswap
+ * and any pending batch.  For zswap to write pages back. */
+void swap_write_slot(size_t slot, const void *kva) {
+    const void *sectors[SECTORS_PER_SLOT];
+    size_t i;
+
+    for (i = 0; i < SECTORS_PER_SLOT; i++)
+        sectors[i] = (const uint8_t *)kva + i * DISK_SECTOR_SIZE;
+    disk_writev(swap_disk, slot * SECTORS_PER_SLOT, sectors, SECTORS_PER_SLOT);
+    slots_written(slot, 1);
+    out_cnt++;
+    write_cnt++;
+}
+
+/* Reads SLOT into the page at KVA, from zswap or the swap cache
+ * if it is there and from disk otherwise.  The slot stays in use.
+ * A read from disk also reads ahead the slots that follow SLOT
+ * into the swap cache, in the same command, for as long as they
+ * hold pages on disk that are not cached already. */
+void swap_in_page(size_t slot, void *kva) {
+    void *sectors[SWAP_CLUSTER * SECTORS_PER_SLOT];
+    struct swap_cache_entry *ahead[SWAP_CLUSTER - 1];
+    struct swap_cache_entry *e;
+    uint64_t start = rdtsc();
+    size_t cnt = 0, s, i;
+
+    ASSERT(used_slots != NULL && bitmap_test(used_slots, slot));
+
+    if (zswap_load(slot, kva)) {
+        zin_cnt++;
+        zin_cycles += rdtsc() - start;
+        return;
+    }
+
+    lock_acquire(&swap_lock);
+    e = cache_find(slot);
+    if (e != NULL && !e->loading) {
+        memcpy(kva, e->kva, PGSIZE);
+        e->slot = SWAP_SLOT_NONE;
+        cache_hit_cnt++;
+        lock_release(&swap_lock);
+        return;
+    }
+    for (s = slot + 1; cnt < SWAP_CLUSTER - 1 && s < bitmap_size(used_slots); s++) {
+        if (!bitmap_test(used_slots, s) || bitmap_test(unwritten_slots, s) || cache_find(s) != NULL || (e = cache_alloc()) == NULL)
+            break;
+        e->slot = s;
+        e->loading = true;
+        ahead[cnt++] = e;
+    }
+    lock_release(&swap_lock);
+
+    for (i = 0; i < (cnt + 1) * SECTORS_PER_SLOT; i++) {
+        uint8_t *page = i < SECTORS_PER_SLOT ? kva : ahead[i / SECTORS_PER_SLOT - 1]->kva;
+        sectors[i] = page + i % SECTORS_PER_SLOT * DISK_SECTOR_SIZE;
+    }
+    disk_readv(swap_disk, slot * SECTORS_PER_SLOT, sectors, (cnt + 1) * SECTORS_PER_SLOT);
+
+    /* A slot freed meanwhile has already left the cache. */
+    lock_acquire(&swap_lock);
+    for (i = 0; i < cnt; i++)
+        ahead[i]->loading = false;
+    lock_release(&swap_lock);
+    in_cnt++;
+    ahead_cnt += cnt;
+    in_cycles += rdtsc() - start;
+}
+
+/* Returns true if SLOT's page is in the swap cache, so that
+ * swapping it in needs no disk read. */
+bool swap_is_cached(size_t slot) {
+    struct swap_cache_entry *e;
+    bool cached;
+
+    if (used_slots == NULL)
+        return false;
+    lock_acquire(&swap_lock);
+    e = cache_find(slot);
+    cached = e != NULL && !e->loading;
+    lock_release(&swap_lock);
+    return cached;
+}
+
+/* Releases SLOT, which belonged to the process whose table is
+ * SPT. */
+void swap_free(struct supplemental_page_table *spt, size_t slot) {
+    struct swap_cache_entry *e;
+
+    zswap_invalidate(slot);
+    lock_acquire(&swap_lock);
+    ASSERT(bitmap_test(used_slots, slot));
+    bitmap_reset(used_slots, slot);
+    bitmap_reset(unwritten_slots, slot);
+    if ((e = cache_find(slot)) != NULL)
+        e->slot = SWAP_SLOT_NONE;
+    spt->swap_cnt--;
+    lock_release(&swap_lock);
+}
+
+/* Starts a batch of swap-outs.  The cursor moves to a run of
+ * SWAP_CLUSTER free slots, if there is one, so that the batch can
+ * go out in a single write. */
+void swap_plug(void) {
+    size_t run;
+
+    ASSERT(!plugged);
+
+    plugged = true;
+    if (used_slots == NULL)
+        return;
+
+    lock_acquire(&swap_lock);
+    run = bitmap_scan(used_slots, next_slot, SWAP_CLUSTER, false);
+    if (run == BITMAP_ERROR)
+        run = bitmap_scan(used_slots, 0, SWAP_CLUSTER, false);
+    if (run != BITMAP_ERROR)
+        next_slot = run;
+    lock_release(&swap_lock);
+}
+
+/* Ends a batch of swap-outs, writing whatever is still pending. */
+void swap_unplug(void) {
+    ASSERT(plugged);
+
+    batch_flush();
+    plugged = false;
+}
+
+/* Prints swap statistics. */
+void swap_print_stats(void) {
+    printf("Swap: %lld pages out in %lld writes, %lld pages in from disk (%lld cycles each), %lld from zswap (%lld cycles each)\n", out_cnt, write_cnt, in_cnt, in_cnt > 0 ? in_cycles / in_cnt : 0, zin_cnt,
+           zin_cnt > 0 ? zin_cycles / zin_cnt : 0);
+    printf("Swap: %lld pages read ahead (%lld pages per read), %lld swap-ins from the swap cache\n", ahead_cnt, in_cnt > 0 ? (in_cnt + ahead_cnt) / in_cnt : 0, cache_hit_cnt);
+    zswap_print_stats();
+}
@@ -2,4 +2,10 @@ vm_SRC = vm/vm.c          # Main api proxy
 vm_SRC += vm/uninit.c     # Uninitialized page
 vm_SRC += vm/anon.c       # Anonymous page
 vm_SRC += vm/file.c       # File mapped page
+vm_SRC += vm/vma.c        # Virtual memory areas
+vm_SRC += vm/swap.c       # Swap slots
+vm_SRC += vm/zswap.c      # Compressed swap cache
+vm_SRC += vm/text.c       # Shared executable pages
+vm_SRC += vm/ksm.c        # Same-page merging
+vm_SRC += vm/pcache.c     # Page cache
 vm_SRC += vm/inspect.c    # Testing utility
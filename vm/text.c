@@ -0,0 +1,138 @@
+/* text.c: Executable pages shared between processes.
+ *
+ * A page of an executable segment that holds file contents is
+ * cached by where it comes from: the sector of the executable's
+ * inode, the offset in the file, and how many bytes of the page
+ * the file fills.  Another process running the same program maps
+ * the cached frame instead of reading a copy of its own.
+ *
+ * A cached frame is only ever mapped read-only.  Code cannot be
+ * written anyway, and the first write to a data page copies it,
+ * just as after fork.  An executable cannot be written while a
+ * process runs it, and a page stays cached only while some
+ * process maps it, so the cache never goes stale.
+ *
+ * The cache is protected by the frame lock, which callers hold. */
+
+#include "vm/text.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+
+/* A cached page. */
+struct text_page {
+    struct hash_elem elem; /* Element in PAGES. */
+    disk_sector_t sector;  /* Inode of the executable. */
+    off_t offset;          /* Offset of the page in the file. */
+    size_t read_bytes;     /* Bytes of the page read from the file. */
+    struct frame *frame;   /* Frame holding the page. */
+};
+
+static struct hash pages;
+
+/* Statistics. */
+static long long insert_cnt; /* # of pages cached. */
+static long long hit_cnt;    /* # of pages mapped from the cache. */
+
+static uint64_t text_hash(const struct hash_elem *e, void *aux UNUSED);
+static bool text_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED);
+
+/* Sets up the cache. */
+void text_init(void) { hash_init(&pages, text_hash, text_less, NULL); }
+
+/* Prints cache statistics. */
+void text_print_stats(void) { printf("Text: %zu pages cached, %lld cached in all, %lld mappings shared\n", hash_size(&pages), insert_cnt, hit_cnt); }
+
+/* Fills in the key of *KEY for PAGE and returns true if PAGE is
+ * one the cache can hold: a page of an executable segment with
+ * file contents, which holds just what the file does, or will
+ * once it is loaded. */
+static bool text_key(struct page *page, struct text_page *key) {
+    struct vma *vma = page->vma;
+    size_t ofs;
+
+    if (vma == NULL || (vma->kind != VMA_CODE && vma->kind != VMA_DATA) || vma->file == NULL)
+        return false;
+    if (page_get_type(page) != VM_ANON || (VM_TYPE(page->operations->type) == VM_ANON && page->anon.slot != SWAP_SLOT_NONE))
+        return false;
+
+    ofs = (uint8_t *)page->va - (uint8_t *)vma_start(vma);
+    if (ofs >= vma->file_bytes)
+        return false;
+    key->sector = inode_get_inumber(file_get_inode(vma->file));
+    key->offset = vma->offset + ofs;
+    key->read_bytes = vma->file_bytes - ofs < PGSIZE ? vma->file_bytes - ofs : PGSIZE;
+    return true;
+}
+
+/* Returns the cached entry matching KEY, or a null pointer. */
+static struct text_page *text_lookup(struct text_page *key) {
+    struct hash_elem *e = hash_find(&pages, &key->elem);
+    return e != NULL ? hash_entry(e, struct text_page, elem) : NULL;
+}
+
+/* Returns the cached frame holding what PAGE, which has no frame,
+ * would load, or a null pointer. */
+struct frame *text_find(struct page *page) {
+    struct text_page key, *t;
+
+    ASSERT(page->frame == NULL);
+
+    if (!text_key(page, &key) || (t = text_lookup(&key)) == NULL)
+        return NULL;
+    hit_cnt++;
+    return t->frame;
+}
+
+/* Caches the frame of PAGE, which must hold just what PAGE's area
+ * loads into it.  Returns true if the frame is now cached, in
+ * which case PAGE must be mapped read-only. */
+bool text_insert(struct page *page) {
+    struct frame *frame = page->frame;
+    struct text_page key, *t;
+
+    if (frame->text != NULL || !text_key(page, &key) || text_lookup(&key) != NULL)
+        return false;
+    if ((t = malloc(sizeof *t)) == NULL)
+        return false;
+    *t = key;
+    t->frame = frame;
+    hash_insert(&pages, &t->elem);
+    frame->text = t;
+    insert_cnt++;
+    return true;
+}
+
+/* Drops FRAME from the cache, if it is there. */
+void text_remove(struct frame *frame) {
+    struct text_page *t = frame->text;
+
+    if (t == NULL)
+        return;
+    hash_delete(&pages, &t->elem);
+    free(t);
+    frame->text = NULL;
+}
+
+/* Returns a hash value for cached page E. */
+static uint64_t text_hash(const struct hash_elem *e, void *aux UNUSED) {
+    const struct text_page *t = hash_entry(e, struct text_page, elem);
+    return hash_int(t->sector) ^ hash_int(t->offset) ^ hash_int(t->read_bytes);
+}
+
+/* Returns true if cached page A precedes cached page B. */
+static bool text_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED) {
+    const struct text_page *a = hash_entry(a_, struct text_page, elem);
+    const struct text_page *b = hash_entry(b_, struct text_page, elem);
+
+    if (a->sector != b->sector)
+        return a->sector < b->sector;
+    if (a->offset != b->offset)
+        return a->offset < b->offset;
+    return a->read_bytes < b->read_bytes;
+}
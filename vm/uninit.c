@@ -8,8 +8,8 @@
  * function.
  * */
 
-#include "vm/uninit.h"
 #include "vm/vm.h"
+#include "vm/uninit.h"
 
 static bool uninit_initialize(struct page *page, void *kva);
 static void uninit_destroy(struct page *page);
@@ -49,12 +49,21 @@ static bool uninit_initialize(struct page *page, void *kva) {
     return uninit->page_initializer(page, uninit->type, kva) && (init ? init(page, aux) : true);
 }
 
+/* Turns PAGE into a page of its final type without filling it, for
+ * a page about to share a frame that already holds its contents:
+ * a frame of the text cache, or the zero frame for an anonymous
+ * page its area would fill with zeros. */
+bool uninit_transmute(struct page *page) {
+    struct uninit_page *uninit = &page->uninit;
+    return uninit->page_initializer(page, uninit->type, NULL);
+}
+
 /* Free the resources hold by uninit_page. Although most of pages are transmuted
  * to other page objects, it is possible to have uninit pages when the process
  * exit, which are never referenced during the execution.
  * PAGE will be freed by the caller. */
 static void uninit_destroy(struct page *page) {
-    struct uninit_page *uninit UNUSED = &page->uninit;
-    /* TODO: Fill this function.
-     * TODO: If you don't have anything to do, just return. */
+    /* Aux, if any, belongs to the caller; a page that failed to
+     * initialize may still hold a frame, though. */
+    vm_free_frame(page);
 }
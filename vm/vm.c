@@ -1,8 +1,140 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
 #include "vm/vm.h"
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 #include "vm/inspect.h"
+#include <intrinsic.h>
+#include <mman.h>
+#include <round.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Most stack pages mapped by one stack fault. */
+#define STACK_FAULT_PAGES 8
+
+/* Most pages read ahead of a sequential run of faults. */
+#define READ_AHEAD_MAX 64
+
+/* Most pages vm_populate() reads from a file at once. */
+#define POPULATE_BATCH 16
+
+/* Most file pages written back at once. */
+#define WRITEBACK_MAX 64
+
+/* How often the merging scanner runs, in milliseconds. */
+#define KSM_INTERVAL 100
+
+/* Frame table: every frame from the user pool that holds a page,
+ * in a ring swept by the clock hand.  A frame taken by eviction
+ * keeps its place just behind the hand, and new frames go there
+ * too, so the frame under the hand is always the one that has
+ * gone longest without being looked at.
+ *
+ * FRAME_LOCK protects the table and the links between frames and
+ * the pages that map them.  Eviction holds it while it writes a
+ * victim out, and pages are destroyed with it held, so that a
+ * page is never freed out from under the clock or evicted halfway
+ * through its own teardown.  A frame is freed when its last page
+ * lets go of it and nobody has it pinned, unless it is in the page
+ * cache, which keeps it until eviction takes it. */
+static struct list frame_table;
+static size_t frame_cnt;
+static struct list_elem *clock_hand;
+static struct lock frame_lock;
+
+/* Frame descriptors, one for each page of the user pool, indexed
+ * by frame number: the page's distance from POOL_BASE.  Each keeps
+ * the reverse map of the pages that map its frame, each page
+ * naming its owner's page table and its address there, so a frame
+ * is unmapped from every process in time linear in its mappers. */
+static struct frame *frames;
+static uint8_t *pool_base;
+static size_t pool_pages;
+
+/* The shared zero frame.  A read fault on anonymous memory that
+ * has never been written maps it instead of a frame of its own,
+ * and the merging scanner maps every all-zero anonymous page it
+ * finds to it.  It stays pinned, so it is never evicted or freed,
+ * and it is never mapped writable: the first write to a page that
+ * maps it copies it, as for any other shared frame.  It does not
+ * count towards any process's resident set. */
+static struct frame *zero_frame;
+static uint64_t zero_checksum;
+
+/* Frame number the merging scanner visits next. */
+static size_t ksm_cursor;
+
+/* -evict-fifo: evict frames in allocation order, ignoring use. */
+bool vm_evict_fifo;
+
+/* -fault-around=N: pages of an executable segment mapped per fault. */
+size_t vm_fault_around = 8;
+
+/* -stack-limit=KB: largest the user stack may grow, in bytes. */
+size_t vm_stack_limit = 1 << 20;
+
+/* -wb-interval=MS, -wb-batch=N: writeback daemon tunables. */
+unsigned vm_wb_interval = 1000;
+size_t vm_wb_batch = 16;
+
+/* -ksm=N: frames the merging scanner visits every KSM_INTERVAL ms. */
+size_t vm_ksm_pages = 64;
+
+/* -rss-limit=N: default resident set limit of a process, in pages. */
+size_t vm_rss_limit;
+
+/* -no-huge: map anonymous memory with 4 kB pages only. */
+bool vm_huge_pages = true;
+
+/* -rusage: print each process's fault counts when it exits. */
+bool vm_rusage_on_exit;
+
+/* Number of programs loaded, for the fault statistics. */
+long long vm_exec_cnt;
+
+/* Statistics. */
+static long long evict_cnt;       /* # of frames evicted. */
+static long long evict_dirty_cnt; /* # of those that had to be written. */
+static long long clock_scan_cnt;  /* # of frames the clock hand passed. */
+static long long fork_share_cnt;  /* # of pages shared by fork. */
+static long long cow_fault_cnt;   /* # of writes to shared frames. */
+static long long cow_copy_cnt;    /* # of those that had to copy. */
+static long long fault_cnt;       /* # of faults that mapped a page. */
+static long long around_cnt;      /* # of pages mapped around a fault. */
+static long long ahead_cnt;       /* # of pages read ahead of a run. */
+static long long stack_fault_cnt; /* # of faults in the stack. */
+static long long stack_page_cnt;  /* # of stack pages those mapped. */
+static long long populate_cnt;    /* # of pages loaded in batches. */
+static long long dropped_cnt;     /* # of pages dropped by MADV_DONTNEED. */
+static long long wb_page_cnt;     /* # of file pages written back early. */
+static long long wb_batch_cnt;    /* # of batches the daemon wrote. */
+static long long msync_cnt;       /* # of msync() calls. */
+static long long ksm_scan_cnt;    /* # of frames checksummed for merging. */
+static long long ksm_merge_cnt;   /* # of frames freed by merging. */
+static long long ksm_zero_cnt;    /* # of those that held only zeros. */
+static uint64_t ksm_cycles;       /* TSC cycles the merging scanner took. */
+static long long local_evict_cnt; /* # of frames evicted from processes at their RSS limit. */
+static long long huge_fault_cnt;  /* # of faults that mapped a huge page. */
+static long long zero_fault_cnt;  /* # of read faults that mapped the zero frame. */
+static long long cache_fill_cnt;  /* # of pages read into the page cache. */
+static long long cache_map_cnt;   /* # of file pages mapped to the page cache. */
+static struct fault_usage fault_totals[RUSAGE_FAULT_KINDS]; /* All processes' faults. */
+
+/* Names of the RUSAGE_* fault kinds. */
+static const char *fault_kind_names[RUSAGE_FAULT_KINDS] = {"minor", "major", "COW", "stack"};
+
+static struct frame *vm_get_frame(bool evict);
+static void flusher(void *aux);
+static void ksm_scanner(void *aux);
+static void inspect_fault_cnt(struct intr_frame *f);
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -14,7 +146,56 @@ void vm_init(void) {
 #endif
     register_inspect_intr();
     /* DO NOT MODIFY UPPER LINES. */
-    /* TODO: Your code goes here. */
+    list_init(&frame_table);
+    clock_hand = NULL;
+    lock_init(&frame_lock);
+    pool_base = palloc_user_pool(&pool_pages);
+    frames = palloc_get_multiple(PAL_ASSERT | PAL_ZERO, DIV_ROUND_UP(pool_pages * sizeof *frames, PGSIZE));
+    text_init();
+    ksm_init();
+    pcache_init();
+
+    zero_frame = vm_get_frame(false);
+    ASSERT(zero_frame != NULL);
+    memset(zero_frame->kva, 0, PGSIZE);
+    zero_frame->flags |= FRAME_ZERO;
+    zero_checksum = ksm_checksum(zero_frame->kva);
+
+    if (vm_wb_interval > 0)
+        thread_create("flusher", PRI_DEFAULT, flusher, NULL);
+    if (vm_ksm_pages > 0)
+        thread_create("ksmd", PRI_MIN, ksm_scanner, NULL);
+
+    /* Tests read fault counts through int 0x45, next to the
+     * inspection hook of int 0x42. */
+    intr_register_int(0x45, 3, INTR_OFF, inspect_fault_cnt, "Inspect Page Fault Count");
+}
+
+/* Prints virtual memory statistics. */
+void vm_print_stats(void) {
+    int i;
+
+    printf("VM: %lld frames evicted (%lld dirty, %lld by RSS limits), %lld clock steps, %s eviction\n", evict_cnt, evict_dirty_cnt, local_evict_cnt, clock_scan_cnt, vm_evict_fifo ? "FIFO" : "clock");
+    printf("VM: %lld pages shared by fork, %lld copy-on-write faults, %lld pages copied\n", fork_share_cnt, cow_fault_cnt, cow_copy_cnt);
+    printf("VM: %lld page faults over %lld execs (%lld per exec), %lld pages faulted around, %lld read ahead\n", fault_cnt, vm_exec_cnt, vm_exec_cnt > 0 ? fault_cnt / vm_exec_cnt : 0, around_cnt, ahead_cnt);
+    for (i = 0; i < RUSAGE_FAULT_KINDS; i++) {
+        const struct fault_usage *u = &fault_totals[i];
+        int b;
+
+        printf("VM: %lld %s faults, %lld cycles each; by 2**%d cycles:", u->cnt, fault_kind_names[i], u->cnt > 0 ? u->cycles / u->cnt : 0, RUSAGE_HIST_SHIFT);
+        for (b = 0; b < RUSAGE_HIST_BUCKETS; b++)
+            printf(" %lld", u->hist[b]);
+        printf("\n");
+    }
+    printf("VM: %lld stack faults mapped %lld stack pages\n", stack_fault_cnt, stack_page_cnt);
+    printf("VM: %lld faults mapped huge pages (%lld pages), %lld read faults mapped the zero frame\n", huge_fault_cnt, huge_fault_cnt * (long long)HPGPAGES, zero_fault_cnt);
+    printf("VM: %lld pages populated in batches, %lld dropped by advice\n", populate_cnt, dropped_cnt);
+    printf("VM: %lld frames scanned for merging in %llu cycles, %lld freed (%lld all zeros), %zu pages on the zero frame\n", ksm_scan_cnt, (unsigned long long)ksm_cycles, ksm_merge_cnt, ksm_zero_cnt, (size_t)zero_frame->map_cnt);
+    printf("VM: %lld file pages written back in %lld batches, %lld msync calls\n", wb_page_cnt, wb_batch_cnt, msync_cnt);
+    printf("VM: %lld pages read into the page cache, %lld file pages mapped to it\n", cache_fill_cnt, cache_map_cnt);
+    swap_print_stats();
+    text_print_stats();
+    pcache_print_stats();
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -31,96 +212,965 @@ enum vm_type page_get_type(struct page *page) {
 }
 
 /* Helpers */
-static struct frame *vm_get_victim(void);
+static struct frame *vm_get_victim(struct thread *owner);
 static bool vm_do_claim_page(struct page *page);
-static struct frame *vm_evict_frame(void);
+static bool vm_claim_in_frame(struct page *page, struct frame *frame);
+static bool vm_share_text(struct page *page);
+static bool vm_map_cache(struct page *page);
+static uint8_t *vm_populate(struct supplemental_page_table *spt, struct vma *vma, uint8_t *start, uint8_t *end, bool evict);
+static struct frame *vm_evict_frame(struct thread *owner);
+static struct page *page_create(struct supplemental_page_table *spt, struct vma *vma, enum vm_type type, void *upage, bool writable, vm_initializer *init, void *aux);
+static struct page *page_from_vma(struct supplemental_page_table *spt, void *va);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
  * `vm_alloc_page`. */
 bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writable, vm_initializer *init, void *aux) {
 
-    ASSERT(VM_TYPE(type) != VM_UNINIT)
+    ASSERT(VM_TYPE(type) != VM_UNINIT);
 
     struct supplemental_page_table *spt = &thread_current()->spt;
 
     /* Check wheter the upage is already occupied or not. */
-    if (spt_find_page(spt, upage) == NULL) {
-        /* TODO: Create the page, fetch the initialier according to the VM type,
-         * TODO: and then create "uninit" page struct by calling uninit_new. You
-         * TODO: should modify the field after calling the uninit_new. */
+    if (spt_find_page(spt, upage) != NULL)
+        return false;
+    return page_create(spt, vma_find(spt, upage), type, upage, writable, init, aux) != NULL;
+}
+
+/* Creates an uninit page at UPAGE in SPT, belonging to VMA, that
+ * will become a page of TYPE initialized by INIT on first fault.
+ * Returns the page, or a null pointer on failure. */
+static struct page *page_create(struct supplemental_page_table *spt, struct vma *vma, enum vm_type type, void *upage, bool writable, vm_initializer *init, void *aux) {
+    bool (*initializer)(struct page *, enum vm_type, void *);
+    struct page *page;
 
-        /* TODO: Insert the page into the spt. */
+    switch (VM_TYPE(type)) {
+    case VM_ANON:
+        initializer = anon_initializer;
+        break;
+    case VM_FILE:
+        initializer = file_backed_initializer;
+        break;
+    default:
+        return NULL;
+    }
+
+    page = malloc(sizeof *page);
+    if (page == NULL)
+        return NULL;
+    uninit_new(page, upage, init, type, aux, initializer);
+    page->writable = writable;
+    page->owner = thread_current();
+    page->vma = vma;
+    if (!spt_insert_page(spt, page)) {
+        free(page);
+        return NULL;
     }
-err:
-    return false;
+    return page;
+}
+
+/* Returns the page of SPT at VA, creating it from the area that
+ * contains VA if it has not been touched before.  Returns a null
+ * pointer if VA is not mapped. */
+static struct page *page_from_vma(struct supplemental_page_table *spt, void *va) {
+    struct page *page = spt_find_page(spt, va);
+    struct vma *vma;
+
+    if (page != NULL)
+        return page;
+    vma = vma_find(spt, va);
+    if (vma == NULL)
+        return NULL;
+    return page_create(spt, vma, vma->type, pg_round_down(va), vma->writable, vma_load_page, NULL);
+}
+
+/* Returns a hash value for page P. */
+static uint64_t page_hash(const struct hash_elem *p_, void *aux UNUSED) {
+    const struct page *p = hash_entry(p_, struct page, spt_elem);
+    return hash_bytes(&p->va, sizeof p->va);
+}
+
+/* Returns true if page A precedes page B. */
+static bool page_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED) {
+    const struct page *a = hash_entry(a_, struct page, spt_elem);
+    const struct page *b = hash_entry(b_, struct page, spt_elem);
+    return a->va < b->va;
 }
 
 /* Find VA from spt and return page. On error, return NULL. */
-struct page *spt_find_page(struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-    struct page *page = NULL;
-    /* TODO: Fill this function. */
+struct page *spt_find_page(struct supplemental_page_table *spt, void *va) {
+    struct page key;
+    struct hash_elem *e;
 
-    return page;
+    key.va = pg_round_down(va);
+    e = hash_find(&spt->pages, &key.spt_elem);
+    return e != NULL ? hash_entry(e, struct page, spt_elem) : NULL;
 }
 
 /* Insert PAGE into spt with validation. */
-bool spt_insert_page(struct supplemental_page_table *spt UNUSED, struct page *page UNUSED) {
-    int succ = false;
-    /* TODO: Fill this function. */
-
-    return succ;
+bool spt_insert_page(struct supplemental_page_table *spt, struct page *page) {
+    if (hash_insert(&spt->pages, &page->spt_elem) != NULL)
+        return false;
+    if (page->vma != NULL)
+        list_push_back(&page->vma->pages, &page->vma_elem);
+    return true;
 }
 
 void spt_remove_page(struct supplemental_page_table *spt, struct page *page) {
+    hash_delete(&spt->pages, &page->spt_elem);
+    if (page->vma != NULL)
+        list_remove(&page->vma_elem);
+    lock_acquire(&frame_lock);
     vm_dealloc_page(page);
+    lock_release(&frame_lock);
+}
+
+/* Returns the frame after E in the frame table, wrapping around
+ * at the end. */
+static struct list_elem *clock_next(struct list_elem *e) {
+    e = list_next(e);
+    return e != list_end(&frame_table) ? e : list_begin(&frame_table);
+}
+
+/* Adds FRAME to the frame table just behind the clock hand, where
+ * it is the last frame the hand will reach. */
+static void frame_table_insert(struct frame *frame) {
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    if (clock_hand == NULL) {
+        list_push_back(&frame_table, &frame->elem);
+        clock_hand = &frame->elem;
+    } else
+        list_insert(clock_hand, &frame->elem);
+    frame_cnt++;
+}
+
+/* Removes FRAME from the frame table. */
+static void frame_table_remove(struct frame *frame) {
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    if (clock_hand == &frame->elem) {
+        clock_hand = clock_next(clock_hand);
+        if (clock_hand == &frame->elem)
+            clock_hand = NULL;
+    }
+    list_remove(&frame->elem);
+    frame_cnt--;
+}
+
+/* Returns the descriptor of the user pool frame at KVA. */
+static struct frame *frame_from_kva(void *kva) {
+    size_t pfn = ((uint8_t *)kva - pool_base) / PGSIZE;
+
+    ASSERT(pg_ofs(kva) == 0);
+    ASSERT((uint8_t *)kva >= pool_base && pfn < pool_pages);
+    return &frames[pfn];
+}
+
+/* Sets up the descriptor of the free user pool frame at KVA and
+ * adds it to the frame table.  Returns the frame, mapped by no
+ * page but pinned once. */
+static struct frame *frame_init(void *kva) {
+    struct frame *frame = frame_from_kva(kva);
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    ASSERT(!(frame->flags & FRAME_USED));
+
+    frame->kva = kva;
+    list_init(&frame->pages);
+    frame->flags = FRAME_USED;
+    frame->pin_cnt = 1;
+    frame->map_cnt = 0;
+    frame->text = NULL;
+    frame->checksum = 0;
+    frame_table_insert(frame);
+    return frame;
+}
+
+/* Removes FRAME from the frame table and frees its page. */
+static void frame_destroy(struct frame *frame) {
+    ASSERT(frame->map_cnt == 0);
+
+    text_remove(frame);
+    ksm_remove(frame);
+    pcache_remove(frame);
+    frame_table_remove(frame);
+    frame->flags &= ~FRAME_USED;
+    palloc_free_page(frame->kva);
+}
+
+/* Adds PAGE to the pages that map FRAME. */
+static void frame_link(struct frame *frame, struct page *page) {
+    struct supplemental_page_table *spt = &page->owner->spt;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    list_push_back(&frame->pages, &page->frame_elem);
+    frame->map_cnt++;
+    page->frame = frame;
+    if (!(frame->flags & FRAME_ZERO) && ++spt->rss_cnt > spt->rss_peak)
+        spt->rss_peak = spt->rss_cnt;
+}
+
+/* Removes PAGE from the pages that map its frame. */
+static void frame_unlink(struct page *page) {
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    list_remove(&page->frame_elem);
+    page->frame->map_cnt--;
+    if (!(page->frame->flags & FRAME_ZERO))
+        page->owner->spt.rss_cnt--;
+    page->frame = NULL;
+}
+
+/* Returns true if every page that maps FRAME belongs to OWNER, or
+ * if OWNER is null. */
+static bool frame_owned_by(struct frame *frame, struct thread *owner) {
+    struct list_elem *e;
+
+    if (owner == NULL)
+        return true;
+    if (frame->map_cnt == 0)
+        return false;
+    for (e = list_begin(&frame->pages); e != list_end(&frame->pages); e = list_next(e))
+        if (list_entry(e, struct page, frame_elem)->owner != owner)
+            return false;
     return true;
 }
 
-/* Get the struct frame, that will be evicted. */
-static struct frame *vm_get_victim(void) {
-    struct frame *victim = NULL;
-    /* TODO: The policy for eviction is up to you. */
+/* Returns true if SPT may not map another frame without giving one
+ * up first. */
+static bool rss_over_limit(struct supplemental_page_table *spt) { return spt->rss_limit > 0 && spt->rss_cnt >= spt->rss_limit; }
 
-    return victim;
+/* Returns true if FRAME may be shared, so that a write to it needs
+ * a copy: more than one page maps it, it is in the text cache,
+ * where another process may look for it, or it is the zero
+ * frame.  A frame of the page cache is never copied, since the
+ * pages that map it are meant to see each other's writes. */
+static bool frame_is_shared(struct frame *frame) { return !(frame->flags & FRAME_CACHE) && (frame->text != NULL || frame->map_cnt > 1 || (frame->flags & FRAME_ZERO)); }
+
+/* Returns true if FRAME may be freed: no page maps it, nobody has
+ * it pinned, and it is not in the page cache. */
+static bool frame_unused(struct frame *frame) { return frame->pin_cnt == 0 && frame->map_cnt == 0 && !(frame->flags & FRAME_CACHE); }
+
+/* Drops a pin on FRAME, freeing it if nothing else holds it. */
+static void frame_unpin(struct frame *frame) {
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    ASSERT(frame->pin_cnt > 0);
+
+    frame->pin_cnt--;
+    if (frame_unused(frame))
+        frame_destroy(frame);
+}
+
+/* Maps PAGE to its frame in its owner's page table, with its dirty
+ * bit set to DIRTY.  The mapping is writable only if PAGE is and
+ * no other page shares the frame. */
+static bool page_map(struct page *page, bool dirty) {
+    uint64_t *pml4 = page->owner->pml4;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    if (!pml4_set_page(pml4, page->va, page->frame->kva, page->writable && !frame_is_shared(page->frame)))
+        return false;
+    pml4_set_dirty(pml4, page->va, dirty);
+    return true;
+}
+
+/* Get the struct frame, that will be evicted.
+ *
+ * The clock hand sweeps the frame table, skipping pinned frames,
+ * and frames that OWNER does not map alone if OWNER is non-null.
+ * A frame that any of its pages accessed since the hand last
+ * passed gets a second chance: the accessed bits are cleared and
+ * the hand moves on.  Of the frames left, a clean one is taken at once, since it
+ * can be dropped without I/O; a dirty one is only remembered, and
+ * taken if a whole turn of the clock finds nothing clean.  Under
+ * -evict-fifo the first unpinned frame is taken regardless.
+ *
+ * A frame of the page cache that no page maps is judged the same
+ * way, with FRAME_REFERENCED for its accessed bit: read() and
+ * write() set it.
+ *
+ * Returns the victim, leaving the hand just past it, or a null
+ * pointer if every frame is pinned. */
+static struct frame *vm_get_victim(struct thread *owner) {
+    struct frame *dirty = NULL;
+    size_t steps;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    /* Two turns: the first may only clear accessed bits. */
+    for (steps = 2 * frame_cnt; steps > 0 && clock_hand != NULL; steps--) {
+        struct frame *frame = list_entry(clock_hand, struct frame, elem);
+        bool accessed = false, modified = false;
+        struct list_elem *e;
+
+        clock_hand = clock_next(clock_hand);
+        clock_scan_cnt++;
+        if (frame->pin_cnt > 0 || !frame_owned_by(frame, owner))
+            continue;
+        if (vm_evict_fifo)
+            return frame;
+
+        if (frame->flags & FRAME_REFERENCED) {
+            frame->flags &= ~FRAME_REFERENCED;
+            accessed = true;
+        }
+        for (e = list_begin(&frame->pages); e != list_end(&frame->pages); e = list_next(e)) {
+            struct page *page = list_entry(e, struct page, frame_elem);
+            uint64_t *pml4 = page->owner->pml4;
+
+            if (pml4_is_accessed(pml4, page->va)) {
+                pml4_set_accessed(pml4, page->va, false);
+                accessed = true;
+            }
+            modified |= pml4_is_dirty(pml4, page->va);
+        }
+        if (accessed)
+            continue;
+        if (!modified)
+            return frame;
+        if (dirty == NULL)
+            dirty = frame;
+        else if (dirty == frame)
+            break;
+    }
+
+    if (dirty != NULL)
+        clock_hand = clock_next(&dirty->elem);
+    return dirty;
+}
+
+/* Clears the mappings of VICTIM's pages and writes each page out,
+ * setting *DIRTY to whether any was modified.  The mappings go
+ * first, so no owner can dirty the frame behind our back; it
+ * faults instead, and waits on the frame lock for eviction to
+ * finish.  A shared frame is written once for each page, since
+ * each keeps its own copy in swap from then on; a frame of the
+ * page cache, by each page that dirtied it, and then it leaves
+ * the cache.
+ *
+ * If a page cannot be written out, the pages not yet written get
+ * their mappings back, keep the frame, and false is returned. */
+static bool frame_page_out(struct frame *victim, bool *dirty) {
+    struct list_elem *e;
+
+    *dirty = false;
+    for (e = list_begin(&victim->pages); e != list_end(&victim->pages); e = list_next(e)) {
+        struct page *page = list_entry(e, struct page, frame_elem);
+
+        pml4_clear_page(page->owner->pml4, page->va);
+        *dirty |= pml4_is_dirty(page->owner->pml4, page->va);
+    }
+
+    while (!list_empty(&victim->pages)) {
+        struct page *page = list_entry(list_front(&victim->pages), struct page, frame_elem);
+
+        if (!swap_out(page)) {
+            for (e = list_begin(&victim->pages); e != list_end(&victim->pages); e = list_next(e)) {
+                page = list_entry(e, struct page, frame_elem);
+                page_map(page, pml4_is_dirty(page->owner->pml4, page->va));
+            }
+            return false;
+        }
+        frame_unlink(page);
+    }
+    return true;
 }
 
 /* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
-static struct frame *vm_evict_frame(void) {
-    struct frame *victim UNUSED = vm_get_victim();
-    /* TODO: swap out the victim and return the evicted frame. */
+ * Return NULL on error.
+ *
+ * Once a victim has to be written, writing is what eviction
+ * costs, so up to SWAP_CLUSTER victims are evicted together:
+ * their swap slots are adjacent and go out in one disk command.
+ * The first frame is returned and the rest go back to the user
+ * pool for the faults that follow. */
+static struct frame *vm_evict_frame(struct thread *owner) {
+    struct frame *victims[SWAP_CLUSTER];
+    size_t cnt = 0, tries, i;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    swap_plug();
+    for (tries = frame_cnt; tries > 0 && cnt < SWAP_CLUSTER; tries--) {
+        struct frame *victim = vm_get_victim(owner);
+        bool dirty;
+
+        if (victim == NULL)
+            break;
+        if (!frame_page_out(victim, &dirty))
+            continue;
+        text_remove(victim);
+        ksm_remove(victim);
+        pcache_remove(victim);
+        victim->checksum = 0;
+
+        victim->pin_cnt++;
+        victims[cnt++] = victim;
+        evict_cnt++;
+        if (!dirty)
+            break;
+        evict_dirty_cnt++;
+    }
+    swap_unplug();
 
-    return NULL;
+    for (i = 1; i < cnt; i++)
+        frame_destroy(victims[i]);
+    return cnt > 0 ? victims[0] : NULL;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
- * and return it. This always return valid address. That is, if the user pool
- * memory is full, this function evicts the frame to get the available memory
- * space.*/
-static struct frame *vm_get_frame(void) {
+ * and return it, unless EVICT is false.  Returns a null pointer if the
+ * user pool is full and nothing can be evicted.
+ *
+ * A process at its resident set limit evicts one of its own frames
+ * instead, so that it pages against itself rather than against
+ * everyone else; if it has none to give up, it gets a frame as
+ * usual.  Without EVICT it gets none.
+ *
+ * The frame comes back in the frame table, mapped by no page but
+ * pinned once, so that it is not chosen for eviction while the
+ * caller fills it; the caller unpins it once its page is mapped. */
+static struct frame *vm_get_frame(bool evict) {
+    struct thread *curr = thread_current();
     struct frame *frame = NULL;
-    /* TODO: Fill this function. */
+    void *kva = NULL;
+
+    lock_acquire(&frame_lock);
+    if (rss_over_limit(&curr->spt)) {
+        if (!evict) {
+            lock_release(&frame_lock);
+            return NULL;
+        }
+        if ((frame = vm_evict_frame(curr)) != NULL) {
+            curr->spt.evict_cnt++;
+            local_evict_cnt++;
+        }
+    }
+    if (frame == NULL && (kva = palloc_get_page(PAL_USER)) == NULL && evict)
+        frame = vm_evict_frame(NULL);
+    else if (kva != NULL)
+        frame = frame_init(kva);
+    lock_release(&frame_lock);
+    return frame;
+}
 
-    ASSERT(frame != NULL);
-    ASSERT(frame->page == NULL);
+/* Unmaps PAGE and unlinks it from its frame, if it has one,
+ * freeing the frame if nothing else holds it.  The caller must
+ * hold the frame lock, as page destructors do. */
+void vm_free_frame(struct page *page) {
+    struct frame *frame = page->frame;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    if (frame == NULL)
+        return;
+    pml4_clear_page(page->owner->pml4, page->va);
+    frame_unlink(page);
+    if (frame_unused(frame))
+        frame_destroy(frame);
+}
+
+/* Returns the frame of the page cache that holds the page of INODE
+ * at OFFSET, a multiple of the page size, pinned.  A page that is
+ * not cached is read into a new frame first if FILL is true, from
+ * the user pool or by eviction; otherwise, or if no frame can be
+ * had, the result is a null pointer.  The caller lets go of the
+ * frame with vm_cache_put(). */
+struct frame *vm_cache_get(struct inode *inode, off_t offset, bool fill) {
+    disk_sector_t sector = inode_get_inumber(inode);
+    struct frame *frame, *twin;
+    off_t length, read_bytes = 0;
+    void *kva;
+    bool ok;
+
+    lock_acquire(&frame_lock);
+    frame = pcache_find(sector, offset);
+    if (frame != NULL) {
+        frame->pin_cnt++;
+        frame->flags |= FRAME_REFERENCED;
+    }
+    if (frame != NULL || !fill) {
+        lock_release(&frame_lock);
+        return frame;
+    }
+    kva = palloc_get_page(PAL_USER);
+    frame = kva != NULL ? frame_init(kva) : vm_evict_frame(NULL);
+    lock_release(&frame_lock);
+    if (frame == NULL)
+        return NULL;
+
+    length = inode_length(inode);
+    if (offset < length)
+        read_bytes = length - offset < PGSIZE ? length - offset : PGSIZE;
+    ok = inode_read_at(inode, frame->kva, read_bytes, offset) == read_bytes;
+    memset((uint8_t *)frame->kva + read_bytes, 0, PGSIZE - read_bytes);
+
+    /* Someone else may have cached the page meanwhile. */
+    lock_acquire(&frame_lock);
+    twin = ok ? pcache_insert(frame, sector, offset) : NULL;
+    if (!ok || twin != NULL) {
+        frame_unpin(frame);
+        frame = twin;
+        if (frame != NULL)
+            frame->pin_cnt++;
+    } else
+        cache_fill_cnt++;
+    if (frame != NULL)
+        frame->flags |= FRAME_REFERENCED;
+    lock_release(&frame_lock);
     return frame;
 }
 
-/* Growing the stack. */
-static void vm_stack_growth(void *addr UNUSED) {}
+/* Lets go of FRAME, which vm_cache_get() returned. */
+void vm_cache_put(struct frame *frame) {
+    lock_acquire(&frame_lock);
+    frame_unpin(frame);
+    lock_release(&frame_lock);
+}
+
+/* Drops every page of INODE from the page cache.  INODE is being
+ * deleted, and nothing maps its pages any more, since a mapping
+ * keeps its file open. */
+void vm_cache_drop(struct inode *inode) {
+    disk_sector_t sector = inode_get_inumber(inode);
+    off_t length = inode_length(inode), offset;
+
+    lock_acquire(&frame_lock);
+    for (offset = 0; offset < length; offset += PGSIZE) {
+        struct frame *frame = pcache_find(sector, offset);
+
+        if (frame == NULL)
+            continue;
+        pcache_remove(frame);
+        if (frame_unused(frame))
+            frame_destroy(frame);
+    }
+    lock_release(&frame_lock);
+}
+
+/* Grows the stack area down to cover ADDR, if ADDR looks like a
+ * stack access: within vm_stack_limit of USER_STACK and at most 8
+ * bytes below RSP, since PUSH writes before it moves RSP.  A fault
+ * above RSP grows the stack down to RSP at once, since a function
+ * that lowered RSP owns everything above it. */
+static bool vm_stack_growth(void *addr, uintptr_t rsp) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    uintptr_t va = (uintptr_t)addr;
+    uintptr_t bottom = va < rsp ? va : rsp;
+
+    if (spt->stack == NULL || va + 8 < rsp || va >= USER_STACK || USER_STACK - bottom > vm_stack_limit)
+        return false;
+    return vma_grow_down(spt, spt->stack, pg_round_down((void *)bottom));
+}
+
+/* Maps more of the stack after a fault on PAGE, which is in it:
+ * the pages above PAGE that have not been touched yet, since a
+ * large array or frame is usually filled from its lowest address
+ * up, and then those between it and RSP, which the program has
+ * already claimed.  At most STACK_FAULT_PAGES are mapped in all,
+ * and only into free frames. */
+static void vm_stack_fault_around(struct supplemental_page_table *spt, struct page *page, uintptr_t rsp) {
+    struct vma *vma = page->vma;
+    uint8_t *va = page->va, *p, *floor;
+    size_t left = STACK_FAULT_PAGES - 1;
+    int dir;
+
+    floor = pg_round_down((void *)rsp);
+    if (floor < (uint8_t *)vma_start(vma))
+        floor = vma_start(vma);
+
+    stack_fault_cnt++;
+    stack_page_cnt++;
+    for (dir = 1; dir >= -1; dir -= 2)
+        for (p = va + dir * PGSIZE; left > 0 && p >= floor && p < (uint8_t *)vma_end(vma); p += dir * PGSIZE) {
+            struct page *n = page_from_vma(spt, p);
+            struct frame *frame;
+
+            if (n == NULL)
+                return;
+            /* Stop at memory that was touched before. */
+            if (VM_TYPE(n->operations->type) != VM_UNINIT)
+                break;
+            if ((frame = vm_get_frame(false)) == NULL || !vm_claim_in_frame(n, frame))
+                return;
+            stack_page_cnt++;
+            left--;
+        }
+}
+
+/* Handle the fault on write_protected page.  A writable page is
+ * mapped read-only while it shares its frame, so this is the
+ * first write to it since fork: it gets a copy of the frame to
+ * itself, or just its write access back if the others have
+ * already let go of the frame. */
+static bool vm_handle_wp(struct page *page) {
+    uint64_t *pml4 = page->owner->pml4;
+    struct frame *old, *new;
+    bool ok = false;
+
+    if (!page->writable)
+        return false;
+
+    lock_acquire(&frame_lock);
+    old = page->frame;
+    if (old == NULL || !frame_is_shared(old)) {
+        /* Evicted since the fault, which will simply recur, or no
+         * longer shared. */
+        ok = old == NULL || page_map(page, pml4_is_dirty(pml4, page->va));
+        lock_release(&frame_lock);
+        return ok;
+    }
+    cow_fault_cnt++;
+    old->pin_cnt++;
+    lock_release(&frame_lock);
+
+    /* The others map OLD read-only, so it cannot change under the
+     * copy, and the pin keeps it from being evicted. */
+    new = vm_get_frame(true);
+    if (new != NULL)
+        memcpy(new->kva, old->kva, PGSIZE);
+
+    lock_acquire(&frame_lock);
+    if (new != NULL) {
+        bool dirty = pml4_is_dirty(pml4, page->va);
+
+        vm_free_frame(page);
+        frame_link(new, page);
+        ok = page_map(page, dirty);
+        if (ok)
+            cow_copy_cnt++;
+        else
+            vm_free_frame(page);
+        frame_unpin(new);
+    }
+    frame_unpin(old);
+    lock_release(&frame_lock);
+    return ok;
+}
+
+/* Handles a fault at VA in VMA, which was advised MADV_SEQUENTIAL:
+ * reads well ahead of the fault, in batches, evicting for it if
+ * need be, and makes the pages already passed over the first the
+ * clock will take, since a sequential reader will not be back. */
+static void vm_read_ahead(struct supplemental_page_table *spt, struct vma *vma, uint8_t *va) {
+    uint8_t *lo = va + PGSIZE, *hi, *behind, *p;
+
+    if (va == vma->ra_next)
+        vma->ra_pages = vma->ra_pages * 2 < READ_AHEAD_MAX ? vma->ra_pages * 2 : READ_AHEAD_MAX;
+    else
+        vma->ra_pages = READ_AHEAD_MAX / 4;
+    hi = (size_t)((uint8_t *)vma_end(vma) - lo) > vma->ra_pages * PGSIZE ? lo + vma->ra_pages * PGSIZE : (uint8_t *)vma_end(vma);
+    vma->ra_next = lo < hi ? vm_populate(spt, vma, lo, hi, true) : lo;
+
+    behind = (size_t)(va - (uint8_t *)vma_start(vma)) > READ_AHEAD_MAX * PGSIZE ? va - READ_AHEAD_MAX * PGSIZE : (uint8_t *)vma_start(vma);
+    lock_acquire(&frame_lock);
+    for (p = behind; p < va; p += PGSIZE) {
+        struct page *page = spt_find_page(spt, p);
+        if (page != NULL && page->frame != NULL)
+            pml4_set_accessed(page->owner->pml4, p, false);
+    }
+    lock_release(&frame_lock);
+}
+
+/* Maps more of the executable segment of PAGE, which has just been
+ * faulted in, to save the faults that would follow.  File mappings
+ * are left alone: mmap() promises to load only what is touched.
+ *
+ * A fault that continues a run, landing just past what the last
+ * one mapped, reads ahead of itself, twice as far as last time up
+ * to READ_AHEAD_MAX pages; any other fault maps the aligned block
+ * of vm_fault_around pages around itself.  Only pages still to be
+ * read from the file are mapped, and only into free frames, so
+ * neither the zero-filled tail of an area nor eviction is paid
+ * for pages that may never be touched. */
+static void vm_fault_around_page(struct supplemental_page_table *spt, struct page *page) {
+    struct vma *vma = page->vma;
+    uint8_t *va = page->va, *lo, *hi, *p;
+    uint8_t *file_end;
+    bool ahead;
+
+    if (vma == NULL || vma->advice == MADV_RANDOM)
+        return;
+    if (vma->advice == MADV_SEQUENTIAL) {
+        vm_read_ahead(spt, vma, va);
+        return;
+    }
+    if ((vma->kind != VMA_CODE && vma->kind != VMA_DATA) || vm_fault_around == 0)
+        return;
+
+    ahead = vma->ra_next == va;
+    if (ahead) {
+        vma->ra_pages = vma->ra_pages * 2 < READ_AHEAD_MAX ? vma->ra_pages * 2 : READ_AHEAD_MAX;
+        lo = va + PGSIZE;
+        hi = lo + vma->ra_pages * PGSIZE;
+    } else {
+        vma->ra_pages = vm_fault_around;
+        lo = (uint8_t *)(pg_no(va) / vm_fault_around * vm_fault_around * PGSIZE);
+        hi = lo + vm_fault_around * PGSIZE;
+    }
+
+    file_end = (uint8_t *)vma_start(vma) + ROUND_UP(vma->file_bytes, PGSIZE);
+    if (lo < (uint8_t *)vma_start(vma))
+        lo = vma_start(vma);
+    if (hi > file_end)
+        hi = file_end;
+
+    for (p = lo; p < hi; p += PGSIZE) {
+        struct page *n;
+        struct frame *frame;
+
+        if (p == va)
+            continue;
+        n = page_from_vma(spt, p);
+        if (n == NULL)
+            break;
+        if (VM_TYPE(n->operations->type) != VM_UNINIT)
+            continue;
+        if (!vm_share_text(n) && ((frame = vm_get_frame(false)) == NULL || !vm_claim_in_frame(n, frame)))
+            break;
+        if (ahead)
+            ahead_cnt++;
+        else
+            around_cnt++;
+    }
+    vma->ra_next = p > va ? p : va + PGSIZE;
+}
+
+/* Maps PAGE, an anonymous page that has never been loaded and that
+ * its area fills with zeros, to the zero frame, for a read fault.
+ * PAGE becomes an anonymous page without running its initializer,
+ * since there is nothing to fill.  Returns false, having changed
+ * nothing, if PAGE needs a frame of its own. */
+static bool vm_zero_fault(struct page *page) {
+    struct vma *vma = page->vma;
+    bool ok = false;
 
-/* Handle the fault on write_protected page */
-static bool vm_handle_wp(struct page *page UNUSED) {}
+    if (vma == NULL || vma->type != VM_ANON || VM_TYPE(page->operations->type) != VM_UNINIT)
+        return false;
+    if ((size_t)((uint8_t *)page->va - (uint8_t *)vma_start(vma)) < vma->file_bytes)
+        return false;
+
+    lock_acquire(&frame_lock);
+    if (uninit_transmute(page)) {
+        frame_link(zero_frame, page);
+        ok = page_map(page, false);
+        if (!ok)
+            vm_free_frame(page);
+    }
+    lock_release(&frame_lock);
+    return ok;
+}
+
+/* Maps the whole huge page of user memory around PAGE, which has
+ * never been loaded, to a huge page of zeros for a write fault on
+ * PAGE, if that memory lies in the zero-filled part of an
+ * anonymous area, other than the stack, and none of it has been
+ * touched.  Read faults map the zero frame instead.  The frames
+ * must come from an aligned run that is free in the user pool:
+ * nothing is evicted for them, and a process with an RSS limit
+ * must have room for all of them.
+ *
+ * Each page of the huge page gets its own frame and descriptor,
+ * as usual, so eviction, fork and the page table walks that change
+ * a single page just split the huge page into ordinary ones.
+ *
+ * Returns true if PAGE was mapped, false if it should be mapped on
+ * its own instead. */
+static bool vm_huge_fault(struct supplemental_page_table *spt, struct page *page) {
+    struct vma *vma = page->vma;
+    uint8_t *start = (uint8_t *)((uintptr_t)page->va & ~HPGMASK), *p;
+    uint8_t *kva;
+    size_t loaded, i;
+    bool huge;
+
+    if (!vm_huge_pages || vma == NULL || vma == spt->stack || vma->type != VM_ANON || !vma->writable || VM_TYPE(page->operations->type) != VM_UNINIT)
+        return false;
+    if (start < (uint8_t *)vma_start(vma) + ROUND_UP(vma->file_bytes, PGSIZE) || start + HPGSIZE > (uint8_t *)vma_end(vma))
+        return false;
+    if (spt->rss_limit > 0 && spt->rss_cnt + HPGPAGES > spt->rss_limit)
+        return false;
+    for (p = start; p < start + HPGSIZE; p += PGSIZE)
+        if (p != page->va && spt_find_page(spt, p) != NULL)
+            return false;
+
+    kva = palloc_get_aligned(PAL_USER, HPGPAGES);
+    if (kva == NULL)
+        return false;
+    for (p = start; p < start + HPGSIZE; p += PGSIZE)
+        if (page_from_vma(spt, p) == NULL) {
+            while ((p -= PGSIZE) >= start)
+                if (p != page->va)
+                    spt_remove_page(spt, spt_find_page(spt, p));
+            palloc_free_multiple(kva, HPGPAGES);
+            return false;
+        }
+
+    lock_acquire(&frame_lock);
+    for (i = 0; i < HPGPAGES; i++)
+        frame_link(frame_init(kva + i * PGSIZE), spt_find_page(spt, start + i * PGSIZE));
+    lock_release(&frame_lock);
+
+    for (loaded = 0; loaded < HPGPAGES; loaded++) {
+        struct page *n = spt_find_page(spt, start + loaded * PGSIZE);
+        if (!swap_in(n, n->frame->kva))
+            break;
+    }
+
+    /* Fall back to ordinary pages for whatever was loaded. */
+    lock_acquire(&frame_lock);
+    huge = loaded == HPGPAGES && pml4_set_huge_page(page->owner->pml4, start, kva, true);
+    for (i = 0; i < HPGPAGES; i++) {
+        struct page *n = spt_find_page(spt, start + i * PGSIZE);
+        struct frame *frame = n->frame;
+
+        if (!huge && (i >= loaded || !page_map(n, false)))
+            vm_free_frame(n);
+        frame_unpin(frame);
+    }
+    lock_release(&frame_lock);
+    return page->frame != NULL;
+}
+
+/* Returns true if the page cache holds the part of the file that
+ * the page at VA of VMA, a file mapping, maps. */
+static bool cache_holds(struct vma *vma, void *va) {
+    off_t offset = vma->offset + ((uint8_t *)va - (uint8_t *)vma_start(vma));
+    bool found;
+
+    lock_acquire(&frame_lock);
+    found = pcache_find(inode_get_inumber(file_get_inode(vma->file)), offset) != NULL;
+    lock_release(&frame_lock);
+    return found;
+}
+
+/* Returns the RUSAGE_* kind of a fault on PAGE of SPT, which has no
+ * frame: major if mapping it reads its file or swap, stack if it
+ * is a new page of the stack, and minor otherwise.  A page that
+ * was read ahead into the swap cache, or a file page the page
+ * cache holds, costs no read. */
+static int fault_kind(struct supplemental_page_table *spt, struct page *page) {
+    struct vma *vma = page->vma;
+
+    switch (VM_TYPE(page->operations->type)) {
+    case VM_UNINIT:
+        if (vma != NULL && vma->file != NULL && (size_t)((uint8_t *)page->va - (uint8_t *)vma_start(vma)) < vma->file_bytes)
+            return vma->kind == VMA_MMAP && cache_holds(vma, page->va) ? RUSAGE_MINOR : RUSAGE_MAJOR;
+        return vma != NULL && vma == spt->stack ? RUSAGE_STACK : RUSAGE_MINOR;
+    case VM_ANON:
+        return page->anon.slot != SWAP_SLOT_NONE && !swap_is_cached(page->anon.slot) ? RUSAGE_MAJOR : RUSAGE_MINOR;
+    case VM_FILE:
+        return page->file.cached && cache_holds(vma, page->va) ? RUSAGE_MINOR : RUSAGE_MAJOR;
+    default:
+        return RUSAGE_MAJOR;
+    }
+}
+
+/* Adds CYCLES to fault usage U. */
+static void fault_usage_add(struct fault_usage *u, uint64_t cycles) {
+    int bucket = 0;
+
+    while (bucket < RUSAGE_HIST_BUCKETS - 1 && cycles >= 1ULL << (bucket + RUSAGE_HIST_SHIFT))
+        bucket++;
+    u->cnt++;
+    u->cycles += cycles;
+    u->hist[bucket]++;
+}
+
+/* Accounts a fault of KIND, handled from TSC value START until now,
+ * to SPT and to the totals. */
+static void fault_account(struct supplemental_page_table *spt, int kind, uint64_t start) {
+    uint64_t cycles = rdtsc() - start;
+
+    fault_usage_add(&spt->faults[kind], cycles);
+    fault_usage_add(&fault_totals[kind], cycles);
+}
+
+/* Returns the number of faults of the RUSAGE_* kind in RAX that the
+ * running process has taken, or of all kinds if RAX is out of
+ * range, in RAX.  Reached through int 0x45. */
+static void inspect_fault_cnt(struct intr_frame *f) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    uint64_t kind = f->R.rax;
+    long long cnt = 0;
+    int i;
+
+    for (i = 0; i < RUSAGE_FAULT_KINDS; i++)
+        if (kind >= RUSAGE_FAULT_KINDS || kind == (uint64_t)i)
+            cnt += spt->faults[i].cnt;
+    f->R.rax = cnt;
+}
+
+/* Fills in USAGE for the running process. */
+void vm_getrusage(struct rusage *usage) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+
+    memcpy(usage->faults, spt->faults, sizeof usage->faults);
+    usage->rss = spt->rss_cnt;
+    usage->rss_peak = spt->rss_peak;
+    usage->rss_limit = spt->rss_limit;
+    usage->swap = spt->swap_cnt;
+    usage->swap_peak = spt->swap_peak;
+    usage->evicted = spt->evict_cnt;
+}
+
+/* Prints the fault counts of the running process, named NAME, if
+ * -rusage was given. */
+void vm_print_rusage(const char *name) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+
+    if (!vm_rusage_on_exit)
+        return;
+    printf("%s: faults: %lld minor, %lld major, %lld COW, %lld stack; rss peak %zu pages\n", name, spt->faults[RUSAGE_MINOR].cnt, spt->faults[RUSAGE_MAJOR].cnt, spt->faults[RUSAGE_COW].cnt, spt->faults[RUSAGE_STACK].cnt, spt->rss_peak);
+}
 
 /* Return true on success */
-bool vm_try_handle_fault(struct intr_frame *f UNUSED, void *addr UNUSED, bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-    struct supplemental_page_table *spt UNUSED = &thread_current()->spt;
-    struct page *page = NULL;
-    /* TODO: Validate the fault */
-    /* TODO: Your code goes here */
+bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user, bool write, bool not_present) {
+    uint64_t start = rdtsc();
+    struct thread *curr = thread_current();
+    struct supplemental_page_table *spt = &curr->spt;
+    struct page *page;
+    uintptr_t rsp;
+    int kind;
 
-    return vm_do_claim_page(page);
+    /* Only missing user pages of a process can be supplied. */
+    if (curr->pml4 == NULL || addr == NULL || !is_user_vaddr(addr))
+        return false;
+    if (!not_present) {
+        page = spt_find_page(spt, addr);
+        if (page == NULL || !write || !vm_handle_wp(page))
+            return false;
+        fault_account(spt, RUSAGE_COW, start);
+        return true;
+    }
+
+    rsp = user ? f->rsp : curr->user_rsp;
+    page = page_from_vma(spt, addr);
+    if (page == NULL && vm_stack_growth(addr, rsp))
+        page = page_from_vma(spt, addr);
+    if (page == NULL || (write && !page->writable))
+        return false;
+
+    kind = fault_kind(spt, page);
+    if (!write && vm_zero_fault(page))
+        zero_fault_cnt++;
+    else if (write && vm_huge_fault(spt, page))
+        huge_fault_cnt++;
+    else if (!vm_do_claim_page(page))
+        return false;
+    else if (page->vma != NULL && page->vma == spt->stack)
+        vm_stack_fault_around(spt, page, rsp);
+    else
+        vm_fault_around_page(spt, page);
+    fault_cnt++;
+
+    /* A frame found in the text cache was not read after all. */
+    if (kind == RUSAGE_MAJOR && page->frame != NULL && page->frame->text != NULL && page->frame->map_cnt > 1)
+        kind = RUSAGE_MINOR;
+    fault_account(spt, kind, start);
+    return true;
 }
 
 /* Free the page.
@@ -131,34 +1181,596 @@ void vm_dealloc_page(struct page *page) {
 }
 
 /* Claim the page that allocate on VA. */
-bool vm_claim_page(void *va UNUSED) {
-    struct page *page = NULL;
-    /* TODO: Fill this function */
+bool vm_claim_page(void *va) {
+    struct page *page = page_from_vma(&thread_current()->spt, va);
 
+    if (page == NULL)
+        return false;
+    if (page->frame != NULL)
+        return true;
     return vm_do_claim_page(page);
 }
 
 /* Claim the PAGE and set up the mmu. */
 static bool vm_do_claim_page(struct page *page) {
-    struct frame *frame = vm_get_frame();
+    struct frame *frame;
+
+    if (vm_share_text(page))
+        return true;
+    if (page_get_type(page) == VM_FILE && VM_TYPE(page->operations->type) == VM_UNINIT && !uninit_transmute(page))
+        return false;
+    if (VM_TYPE(page->operations->type) == VM_FILE && page->file.cached)
+        return vm_map_cache(page);
+    frame = vm_get_frame(true);
+    return frame != NULL && vm_claim_in_frame(page, frame);
+}
+
+/* Maps PAGE, which has no frame, to the frame of the text cache
+ * that already holds its contents, if there is one. */
+static bool vm_share_text(struct page *page) {
+    struct frame *frame;
+    bool ok = false;
+
+    lock_acquire(&frame_lock);
+    frame = text_find(page);
+    if (frame != NULL && (VM_TYPE(page->operations->type) != VM_UNINIT || uninit_transmute(page))) {
+        frame_link(frame, page);
+        ok = page_map(page, false);
+        if (!ok)
+            vm_free_frame(page);
+    }
+    lock_release(&frame_lock);
+    return ok;
+}
+
+/* Maps PAGE, a file page with no frame that maps the page cache,
+ * to the frame that caches its part of the file, reading it in
+ * first if need be.  Every process that maps the same part of the
+ * file maps the same frame, writable if its page is, and read()
+ * and write() copy to and from it, so they all see the same
+ * bytes. */
+static bool vm_map_cache(struct page *page) {
+    struct frame *frame = vm_cache_get(file_get_inode(page->file.file), page->file.offset, true);
+    bool ok;
+
+    if (frame == NULL)
+        return false;
+    lock_acquire(&frame_lock);
+    frame_link(frame, page);
+    ok = page_map(page, false);
+    if (ok)
+        cache_map_cnt++;
+    else
+        vm_free_frame(page);
+    frame_unpin(frame);
+    lock_release(&frame_lock);
+    return ok;
+}
+
+/* Offers FRAME, which has just been filled with what PAGE loads,
+ * to the page cache if PAGE maps the cache, and returns the frame
+ * PAGE should map: FRAME, or the frame that caches the page
+ * already, which may have been written since it was read. */
+static struct frame *cache_offer(struct page *page, struct frame *frame) {
+    struct frame *twin;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    if (VM_TYPE(page->operations->type) != VM_FILE || !page->file.cached)
+        return frame;
+    twin = pcache_insert(frame, inode_get_inumber(file_get_inode(page->file.file)), page->file.offset);
+    if (twin != NULL)
+        return twin;
+    cache_fill_cnt++;
+    return frame;
+}
+
+/* Loads PAGE into FRAME, which vm_get_frame() returned, and maps
+ * it.  Either way, the caller's pin on FRAME is dropped. */
+static bool vm_claim_in_frame(struct page *page, struct frame *frame) {
+    bool ok;
 
     /* Set links */
-    frame->page = page;
-    page->frame = frame;
+    lock_acquire(&frame_lock);
+    frame_link(frame, page);
+    ok = page_map(page, false);
+    lock_release(&frame_lock);
+    ok = ok && swap_in(page, frame->kva);
+
+    /* A page just loaded from an executable is offered to the text
+     * cache, which takes away its write access if it is cached. */
+    lock_acquire(&frame_lock);
+    if (!ok)
+        vm_free_frame(page);
+    else if (!pml4_is_dirty(page->owner->pml4, page->va) && text_insert(page))
+        page_map(page, false);
+    frame_unpin(frame);
+    lock_release(&frame_lock);
+    return ok;
+}
+
+/* Loads the pages of VMA in [START, END) that have never been
+ * loaded, reading each run of up to POPULATE_BATCH of them from
+ * the area's file with a single call, and returns the address it
+ * stopped at: END, unless frames ran out or a read failed.  EVICT
+ * says whether to evict for frames.  Pages that already exist
+ * some other way are left as they are.  Pages of a file mapping
+ * enter the page cache, or map what it holds already. */
+static uint8_t *vm_populate(struct supplemental_page_table *spt, struct vma *vma, uint8_t *start, uint8_t *end, bool evict) {
+    uint8_t *va = start;
+
+    while (va < end) {
+        struct page *pages[POPULATE_BATCH];
+        struct frame *frames[POPULATE_BATCH];
+        void *kvas[POPULATE_BATCH];
+        size_t cnt = 0, ofs, read_bytes = 0, i;
+        bool ok, stop = false;
+
+        /* Gather a run of pages never loaded, with a frame each. */
+        while (va < end && cnt < POPULATE_BATCH) {
+            struct page *page = page_from_vma(spt, va);
+
+            if (page != NULL && VM_TYPE(page->operations->type) != VM_UNINIT) {
+                if (cnt > 0)
+                    break;
+                va += PGSIZE;
+                continue;
+            }
+            if (page == NULL || (frames[cnt] = vm_get_frame(evict)) == NULL) {
+                stop = true;
+                break;
+            }
+            pages[cnt] = page;
+            kvas[cnt] = frames[cnt]->kva;
+            cnt++;
+            va += PGSIZE;
+        }
+        if (cnt == 0)
+            return va;
+
+        ofs = (uint8_t *)pages[0]->va - (uint8_t *)vma_start(vma);
+        if (ofs < vma->file_bytes)
+            read_bytes = vma->file_bytes - ofs < cnt * PGSIZE ? vma->file_bytes - ofs : cnt * PGSIZE;
+        ok = read_bytes == 0 || file_read_pages_at(vma->file, kvas, read_bytes, vma->offset + ofs) == (off_t)read_bytes;
+        for (i = 0; i < cnt; i++) {
+            size_t page_read = read_bytes > i * PGSIZE ? read_bytes - i * PGSIZE : 0;
+
+            if (page_read < PGSIZE)
+                memset((uint8_t *)kvas[i] + page_read, 0, PGSIZE - page_read);
+        }
+
+        lock_acquire(&frame_lock);
+        for (i = 0; i < cnt; i++) {
+            if (ok && uninit_transmute(pages[i])) {
+                frame_link(cache_offer(pages[i], frames[i]), pages[i]);
+                if (page_map(pages[i], false))
+                    populate_cnt++;
+                else
+                    vm_free_frame(pages[i]);
+            }
+            frame_unpin(frames[i]);
+        }
+        lock_release(&frame_lock);
+        if (!ok)
+            return pages[0]->va;
+        if (stop)
+            return va;
+    }
+    return va;
+}
+
+/* Destroys the pages of VMA in [START, END), writing modified file
+ * pages back first, so that they are loaded afresh when touched
+ * again. */
+static void vm_drop_range(struct supplemental_page_table *spt, struct vma *vma, uint8_t *start, uint8_t *end) {
+    struct list_elem *e = list_begin(&vma->pages);
+
+    while (e != list_end(&vma->pages)) {
+        struct page *page = list_entry(e, struct page, vma_elem);
+
+        e = list_next(e);
+        if ((uint8_t *)page->va >= start && (uint8_t *)page->va < end) {
+            spt_remove_page(spt, page);
+            dropped_cnt++;
+        }
+    }
+}
+
+/* Returns true if [START, END), a page-aligned range of user
+ * addresses, is covered by areas of SPT with no gaps. */
+static bool range_mapped(struct supplemental_page_table *spt, uint64_t start, uint64_t end) {
+    uint64_t covered = start;
+    struct itree_elem *e;
+
+    if (end <= start || end > KERN_BASE)
+        return false;
+
+    /* Areas come in order of start and do not overlap. */
+    for (e = itree_first_overlap(&spt->vmas, start, end); e != NULL; e = itree_next_overlap(e, start, end)) {
+        if (e->start > covered)
+            return false;
+        covered = e->end;
+    }
+    return covered >= end;
+}
+
+/* Applies ADVICE, one of the MADV_* values, to the SIZE bytes of
+ * user memory at ADDR, which must be page-aligned and mapped
+ * throughout.  Access-pattern advice applies to whole areas, even
+ * if the range covers only part of one.  Returns 0 on success, -1
+ * on failure. */
+int vm_madvise(void *addr, size_t size, int advice) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    uint64_t start = (uint64_t)addr, end = start + ROUND_UP(size, PGSIZE);
+    struct itree_elem *e;
+
+    if (pg_ofs(addr) != 0 || size == 0 || advice < MADV_NORMAL || advice > MADV_DONTNEED || !range_mapped(spt, start, end))
+        return -1;
+
+    for (e = itree_first_overlap(&spt->vmas, start, end); e != NULL; e = itree_next_overlap(e, start, end)) {
+        struct vma *vma = itree_entry(e, struct vma, elem);
+        uint8_t *lo = (uint8_t *)(e->start > start ? e->start : start);
+        uint8_t *hi = (uint8_t *)(e->end < end ? e->end : end);
+
+        switch (advice) {
+        case MADV_WILLNEED:
+            vm_populate(spt, vma, lo, hi, false);
+            break;
+        case MADV_DONTNEED:
+            vm_drop_range(spt, vma, lo, hi);
+            break;
+        default:
+            vma->advice = advice;
+            vma->ra_next = NULL;
+            break;
+        }
+    }
+    return 0;
+}
+
+/* Sets the resident set limit of the running process to PAGES, or
+ * lifts it if PAGES is 0.  A process above its new limit comes
+ * down to it as it faults, since each fault then gives up one of
+ * its own frames.  Children inherit the limit.  Returns 0. */
+int vm_set_rss_limit(size_t pages) {
+    thread_current()->spt.rss_limit = pages;
+    return 0;
+}
+
+/* Returns true if the merging scanner may merge FRAME, or merge
+ * another frame into it: it holds anonymous memory of one or more
+ * processes, and nobody is filling, copying or evicting it. */
+static bool ksm_mergeable(struct frame *frame) {
+    struct list_elem *e;
+
+    if (!(frame->flags & FRAME_USED) || frame->pin_cnt > 0 || frame->text != NULL || frame->map_cnt == 0)
+        return false;
+    for (e = list_begin(&frame->pages); e != list_end(&frame->pages); e = list_next(e)) {
+        struct page *page = list_entry(e, struct page, frame_elem);
+
+        /* Merging one page of a huge page would split it. */
+        if (VM_TYPE(page->operations->type) != VM_ANON || pml4_is_huge(page->owner->pml4, page->va))
+            return false;
+    }
+    return true;
+}
+
+/* Merges FRAME into TARGET, if they hold the same bytes: FRAME's
+ * pages are moved over to TARGET, every page of TARGET is mapped
+ * read-only so that the next write copies it, and FRAME is freed.
+ * Each page keeps its dirty bit, which says whether it still
+ * matches its area's file.  The compare and the remapping are done
+ * with interrupts off, so that no process can write either frame
+ * in between.  Returns false, changing nothing, if the contents
+ * differ. */
+static bool ksm_merge(struct frame *frame, struct frame *target) {
+    enum intr_level old_level;
+    struct list_elem *e;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    ASSERT(frame != target);
+
+    old_level = intr_disable();
+    if (memcmp(frame->kva, target->kva, PGSIZE) != 0) {
+        intr_set_level(old_level);
+        return false;
+    }
+    while (!list_empty(&frame->pages)) {
+        struct page *page = list_entry(list_front(&frame->pages), struct page, frame_elem);
+
+        frame_unlink(page);
+        frame_link(target, page);
+    }
+    for (e = list_begin(&target->pages); e != list_end(&target->pages); e = list_next(e)) {
+        struct page *page = list_entry(e, struct page, frame_elem);
+        page_map(page, pml4_is_dirty(page->owner->pml4, page->va));
+    }
+    intr_set_level(old_level);
+
+    frame_destroy(frame);
+    ksm_merge_cnt++;
+    return true;
+}
+
+/* Visits FRAME for the merging scanner.  An all-zero frame is
+ * merged into the zero frame at once.  Any other frame is only
+ * offered for merging once its checksum has held steady since the
+ * previous visit, so that memory in active use is left alone. */
+static void ksm_scan_frame(struct frame *frame) {
+    struct frame *twin;
+    uint64_t sum;
+
+    if (!ksm_mergeable(frame))
+        return;
+    ksm_scan_cnt++;
+    sum = ksm_checksum(frame->kva);
+    if (sum == zero_checksum && ksm_merge(frame, zero_frame)) {
+        ksm_zero_cnt++;
+        return;
+    }
+
+    if (frame->flags & FRAME_KSM) {
+        if (frame->checksum == sum)
+            return;
+        ksm_remove(frame);
+    }
+    if (frame->checksum != sum) {
+        frame->checksum = sum;
+        return;
+    }
+
+    twin = ksm_insert(frame);
+    if (twin != NULL && !(ksm_mergeable(twin) && ksm_merge(frame, twin))) {
+        /* TWIN changed since it was entered, or is busy; FRAME
+         * takes its place. */
+        ksm_remove(twin);
+        ksm_insert(frame);
+    }
+}
+
+/* Same-page merging scanner.  Every KSM_INTERVAL milliseconds it
+ * visits the next vm_ksm_pages frames of the user pool, round
+ * robin by frame number, holding the frame lock for one frame at
+ * a time.  It runs at the lowest priority, so it only takes time
+ * that no other thread wants. */
+static void ksm_scanner(void *aux UNUSED) {
+    for (;;) {
+        uint64_t start;
+        size_t i;
+
+        timer_msleep(KSM_INTERVAL);
+        start = rdtsc();
+        for (i = 0; i < vm_ksm_pages; i++) {
+            lock_acquire(&frame_lock);
+            ksm_scan_frame(&frames[ksm_cursor]);
+            lock_release(&frame_lock);
+            ksm_cursor = (ksm_cursor + 1) % pool_pages;
+        }
+        ksm_cycles += rdtsc() - start;
+    }
+}
 
-    /* TODO: Insert page table entry to map page's VA to frame's PA. */
+/* Orders file pages by where their data lies on disk: by file,
+ * then by offset, which follows the sectors of a file's extent. */
+static int writeback_less(const void *a_, const void *b_) {
+    const struct page *a = *(struct page *const *)a_;
+    const struct page *b = *(struct page *const *)b_;
+    disk_sector_t as = inode_get_inumber(file_get_inode(a->file.file));
+    disk_sector_t bs = inode_get_inumber(file_get_inode(b->file.file));
 
-    return swap_in(page, frame->kva);
+    if (as != bs)
+        return as < bs ? -1 : 1;
+    return a->file.offset < b->file.offset ? -1 : a->file.offset > b->file.offset;
+}
+
+/* Writes back the CNT file pages in BATCH, in disk order, and
+ * returns how many were written.  Holding FRAME_LOCK keeps them
+ * from being evicted or destroyed meanwhile. */
+static size_t writeback_pages(struct page **batch, size_t cnt) {
+    size_t i, written = 0;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    qsort(batch, cnt, sizeof *batch, writeback_less);
+    for (i = 0; i < cnt; i++)
+        if (file_backed_write_back(batch[i]))
+            written++;
+    wb_page_cnt += written;
+    return written;
+}
+
+/* Returns true if PAGE is a file page with a frame that its
+ * process has written to since it was last written back. */
+static bool writeback_wanted(struct page *page) { return page->frame != NULL && VM_TYPE(page->operations->type) == VM_FILE && pml4_is_dirty(page->owner->pml4, page->va); }
+
+/* Writes back one batch of up to vm_wb_batch dirty file pages
+ * from anywhere in the frame table.  Returns the number of pages
+ * found dirty. */
+static size_t writeback_batch(void) {
+    struct page *batch[WRITEBACK_MAX];
+    size_t limit = vm_wb_batch < 1 ? 1 : vm_wb_batch > WRITEBACK_MAX ? WRITEBACK_MAX : vm_wb_batch;
+    size_t cnt = 0;
+    struct list_elem *e, *pe;
+
+    lock_acquire(&frame_lock);
+    for (e = list_begin(&frame_table); e != list_end(&frame_table) && cnt < limit; e = list_next(e)) {
+        struct frame *frame = list_entry(e, struct frame, elem);
+
+        for (pe = list_begin(&frame->pages); pe != list_end(&frame->pages) && cnt < limit; pe = list_next(pe)) {
+            struct page *page = list_entry(pe, struct page, frame_elem);
+            if (writeback_wanted(page))
+                batch[cnt++] = page;
+        }
+    }
+    if (cnt > 0) {
+        writeback_pages(batch, cnt);
+        wb_batch_cnt++;
+    }
+    lock_release(&frame_lock);
+    return cnt;
+}
+
+/* Writeback daemon.  Every vm_wb_interval milliseconds, writes
+ * back the file pages that processes have modified, a batch at a
+ * time, so that munmap(), eviction and exit find less to write
+ * and fewer writes are lost if the machine stops.  The lock is
+ * let go between batches, and the number of batches per wakeup
+ * is bounded so that a process that keeps writing cannot keep the
+ * daemon running. */
+static void flusher(void *aux UNUSED) {
+    for (;;) {
+        size_t batches;
+
+        timer_msleep(vm_wb_interval);
+        for (batches = frame_cnt / (vm_wb_batch > 0 ? vm_wb_batch : 1) + 1; batches > 0; batches--)
+            if (writeback_batch() == 0)
+                break;
+    }
+}
+
+/* Writes the modified file pages in the SIZE bytes of user memory
+ * at ADDR, which must be page-aligned and mapped throughout, back
+ * to their files.  FLAGS must be MS_SYNC, to write them before
+ * returning, or MS_ASYNC, to leave them to the writeback daemon;
+ * if the daemon is off, MS_ASYNC writes them now too.  Returns 0
+ * on success, -1 on failure. */
+int vm_msync(void *addr, size_t size, int flags) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    uint64_t start = (uint64_t)addr, end = start + ROUND_UP(size, PGSIZE);
+    struct page *batch[WRITEBACK_MAX];
+    struct itree_elem *e;
+    int result = 0;
+
+    if (pg_ofs(addr) != 0 || size == 0 || (flags != MS_SYNC && flags != MS_ASYNC) || !range_mapped(spt, start, end))
+        return -1;
+
+    msync_cnt++;
+    if (flags == MS_ASYNC && vm_wb_interval > 0)
+        return 0;
+
+    lock_acquire(&frame_lock);
+    for (e = itree_first_overlap(&spt->vmas, start, end); e != NULL; e = itree_next_overlap(e, start, end)) {
+        struct vma *vma = itree_entry(e, struct vma, elem);
+        struct list_elem *pe;
+        size_t cnt = 0;
+
+        if (vma->type != VM_FILE)
+            continue;
+        for (pe = list_begin(&vma->pages); pe != list_end(&vma->pages); pe = list_next(pe)) {
+            struct page *page = list_entry(pe, struct page, vma_elem);
+
+            if ((uint64_t)page->va < start || (uint64_t)page->va >= end || !writeback_wanted(page))
+                continue;
+            batch[cnt++] = page;
+            if (cnt == WRITEBACK_MAX) {
+                if (writeback_pages(batch, cnt) != cnt)
+                    result = -1;
+                cnt = 0;
+            }
+        }
+        if (writeback_pages(batch, cnt) != cnt)
+            result = -1;
+    }
+    lock_release(&frame_lock);
+    return result;
 }
 
 /* Initialize new supplemental page table */
-void supplemental_page_table_init(struct supplemental_page_table *spt UNUSED) {}
+void supplemental_page_table_init(struct supplemental_page_table *spt) {
+    hash_init(&spt->pages, page_hash, page_less, NULL);
+    itree_init(&spt->vmas);
+    spt->stack = NULL;
+    spt->swap_cnt = spt->swap_peak = 0;
+    spt->rss_cnt = spt->rss_peak = 0;
+    spt->rss_limit = vm_rss_limit;
+    spt->evict_cnt = 0;
+    memset(spt->faults, 0, sizeof spt->faults);
+}
+
+/* Copy supplemental page table from src to dst.  Areas are copied
+ * whole.  Of their pages, those with a frame are shared with the
+ * copy, both sides mapping the frame read-only until one of them
+ * writes to it (see vm_handle_wp()); the rest can be created from
+ * the new area as the child touches them.  A page in swap is
+ * brought back first, since its slot cannot be shared. */
+bool supplemental_page_table_copy(struct supplemental_page_table *dst, struct supplemental_page_table *src) {
+    struct itree_elem *e;
+
+    dst->rss_limit = src->rss_limit;
+
+    for (e = itree_first(&src->vmas); e != NULL; e = itree_next(e)) {
+        struct vma *svma = itree_entry(e, struct vma, elem);
+        struct file *file = NULL;
+        struct vma *dvma;
+        struct list_elem *pe;
+
+        if (svma->file != NULL && (file = file_duplicate(svma->file)) == NULL)
+            return false;
+        dvma = vma_create(dst, vma_start(svma), vma_size(svma), svma->kind, svma->type, svma->writable, file, svma->offset, svma->file_bytes);
+        if (dvma == NULL) {
+            file_close(file);
+            return false;
+        }
+        if (svma == src->stack)
+            dst->stack = dvma;
+        dvma->advice = svma->advice;
+
+        for (pe = list_begin(&svma->pages); pe != list_end(&svma->pages); pe = list_next(pe)) {
+            struct page *sp = list_entry(pe, struct page, vma_elem);
+            bool ok = true;
 
-/* Copy supplemental page table from src to dst */
-bool supplemental_page_table_copy(struct supplemental_page_table *dst UNUSED, struct supplemental_page_table *src UNUSED) {}
+            /* Claiming the page may not stick, since the frame
+             * lock is dropped in between. */
+            lock_acquire(&frame_lock);
+            while (sp->frame == NULL && VM_TYPE(sp->operations->type) == VM_ANON && sp->anon.slot != SWAP_SLOT_NONE) {
+                lock_release(&frame_lock);
+                if (!vm_do_claim_page(sp))
+                    return false;
+                lock_acquire(&frame_lock);
+            }
+
+            if (sp->frame != NULL) {
+                /* The copy turns into a page of SP's type without
+                 * loading anything, and takes SP's dirty bit along
+                 * with its frame, so that neither is dropped as
+                 * clean if it no longer matches its area. */
+                struct page *dp = page_create(dst, dvma, page_get_type(sp), sp->va, sp->writable, NULL, NULL);
+
+                ok = dp != NULL && swap_in(dp, sp->frame->kva);
+                if (ok) {
+                    bool dirty = pml4_is_dirty(sp->owner->pml4, sp->va);
+
+                    frame_link(sp->frame, dp);
+                    ok = page_map(sp, dirty) && page_map(dp, dirty);
+                    fork_share_cnt++;
+                }
+            }
+            lock_release(&frame_lock);
+            if (!ok)
+                return false;
+        }
+    }
+    return true;
+}
+
+/* Destroys the page whose hash element is E. */
+static void page_destructor(struct hash_elem *e, void *aux UNUSED) {
+    lock_acquire(&frame_lock);
+    vm_dealloc_page(hash_entry(e, struct page, spt_elem));
+    lock_release(&frame_lock);
+}
 
 /* Free the resource hold by the supplemental page table */
-void supplemental_page_table_kill(struct supplemental_page_table *spt UNUSED) {
-    /* TODO: Destroy all the supplemental_page_table hold by thread and
-     * TODO: writeback all the modified contents to the storage. */
+void supplemental_page_table_kill(struct supplemental_page_table *spt) {
+    struct itree_elem *e;
+
+    /* Kernel threads never initialize theirs. */
+    if (spt->pages.buckets == NULL)
+        return;
+
+    /* Destroying the pages writes modified file pages back. */
+    while ((e = itree_first(&spt->vmas)) != NULL)
+        vma_destroy(spt, itree_entry(e, struct vma, elem));
+    hash_destroy(&spt->pages, page_destructor);
+    spt->pages.buckets = NULL;
 }
@@ -0,0 +1,105 @@
+/* vma.c: Virtual memory areas, the ranges a supplemental page table is
+ * built from. */
+
+#include "vm/vma.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+#include <mman.h>
+#include <string.h>
+
+/* Adds an area of SIZE bytes at START to SPT and returns it.
+ * Bytes [0, FILE_BYTES) of the area come from FILE starting at
+ * OFFSET, and the rest read as zeros.  On success the area owns
+ * FILE, which may be null if FILE_BYTES is 0.  Returns a null
+ * pointer if the range is empty, not in user space, overlaps an
+ * existing area, or memory is short. */
+struct vma *vma_create(struct supplemental_page_table *spt, void *start, size_t size, enum vma_kind kind, enum vm_type type, bool writable, struct file *file, off_t offset, size_t file_bytes) {
+    uint64_t s = (uint64_t)start, e = s + size;
+    struct vma *vma;
+
+    ASSERT(pg_ofs(start) == 0);
+    ASSERT(size % PGSIZE == 0);
+    ASSERT(file != NULL || file_bytes == 0);
+
+    if (size == 0 || e < s || e > KERN_BASE || vma_overlaps(spt, start, size))
+        return NULL;
+
+    vma = malloc(sizeof *vma);
+    if (vma == NULL)
+        return NULL;
+    vma->elem.start = s;
+    vma->elem.end = e;
+    vma->kind = kind;
+    vma->type = type;
+    vma->writable = writable;
+    vma->file = file;
+    vma->offset = offset;
+    vma->file_bytes = file_bytes;
+    list_init(&vma->pages);
+    vma->advice = MADV_NORMAL;
+    vma->ra_next = NULL;
+    vma->ra_pages = 0;
+    itree_insert(&spt->vmas, &vma->elem);
+    return vma;
+}
+
+/* Destroys every page created in VMA, removes VMA from SPT, and
+ * frees it along with its file. */
+void vma_destroy(struct supplemental_page_table *spt, struct vma *vma) {
+    while (!list_empty(&vma->pages))
+        spt_remove_page(spt, list_entry(list_front(&vma->pages), struct page, vma_elem));
+
+    itree_remove(&spt->vmas, &vma->elem);
+    if (spt->stack == vma)
+        spt->stack = NULL;
+    file_close(vma->file);
+    free(vma);
+}
+
+/* Returns the area of SPT that contains VA, or a null pointer. */
+struct vma *vma_find(struct supplemental_page_table *spt, const void *va) {
+    struct itree_elem *e = itree_find(&spt->vmas, (uint64_t)va);
+    return e != NULL ? itree_entry(e, struct vma, elem) : NULL;
+}
+
+/* Returns true if any area of SPT overlaps the SIZE bytes at
+ * START. */
+bool vma_overlaps(struct supplemental_page_table *spt, const void *start, size_t size) { return size > 0 && itree_first_overlap(&spt->vmas, (uint64_t)start, (uint64_t)start + size) != NULL; }
+
+/* Extends VMA, which must be an anonymous area with no file
+ * behind it, down so that it begins at NEW_START.  Fails if that
+ * would run into another area. */
+bool vma_grow_down(struct supplemental_page_table *spt, struct vma *vma, void *new_start) {
+    ASSERT(pg_ofs(new_start) == 0);
+    ASSERT(vma->file == NULL);
+
+    if (new_start >= vma_start(vma))
+        return true;
+    if (vma_overlaps(spt, new_start, (uint8_t *)vma_start(vma) - (uint8_t *)new_start))
+        return false;
+
+    /* The start is the tree's key, so re-insert. */
+    itree_remove(&spt->vmas, &vma->elem);
+    vma->elem.start = (uint64_t)new_start;
+    itree_insert(&spt->vmas, &vma->elem);
+    return true;
+}
+
+/* Page initializer for pages created from an area: fills PAGE's
+ * frame with its share of the area's file bytes and zeros the
+ * rest. */
+bool vma_load_page(struct page *page, void *aux UNUSED) {
+    struct vma *vma = page->vma;
+    uint8_t *kva = page->frame->kva;
+    size_t ofs = (uint8_t *)page->va - (uint8_t *)vma_start(vma);
+    size_t read_bytes = ofs < vma->file_bytes ? vma->file_bytes - ofs : 0;
+
+    if (read_bytes > PGSIZE)
+        read_bytes = PGSIZE;
+    if (read_bytes > 0 && file_read_at(vma->file, kva, read_bytes, vma->offset + ofs) != (off_t)read_bytes)
+        return false;
+    memset(kva + read_bytes, 0, PGSIZE - read_bytes);
+    return true;
+}
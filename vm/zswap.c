@@ -0,0 +1,183 @@
+/* zswap.c: Compressed cache in front of the swap disk.
+ *
+ * A page on its way to a swap slot is first compressed into a
+ * bounded pool in the kernel heap, keyed by the slot.  Only when
+ * the pool is full are its least recently stored pages written to
+ * their slots on disk, so a page that is swapped back in soon
+ * costs a decompression rather than a PIO read.  Pages that do
+ * not compress well skip the pool and go straight to disk. */
+
+#include "vm/zswap.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/swap.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <lz.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Most bytes the pool may hold, entry headers included. */
+#define ZSWAP_MAX_BYTES (1024 * 1024)
+
+/* Pages that compress to more than this go to disk instead. */
+#define ZSWAP_MAX_ENTRY (PGSIZE * 3 / 4)
+
+/* A compressed page. */
+struct zswap_entry {
+    struct hash_elem elem;     /* Element in ENTRIES, keyed by SLOT. */
+    struct list_elem lru_elem; /* Element in LRU. */
+    size_t slot;               /* Swap slot the page belongs in. */
+    size_t size;               /* Bytes in DATA. */
+    uint8_t data[];            /* Compressed page. */
+};
+
+static struct hash entries;   /* Pages in the pool, by slot. */
+static struct list lru;       /* Pages in the pool, oldest first. */
+static size_t pool_bytes;     /* Bytes the pool takes up. */
+static struct lock zswap_lock;
+static bool enabled;
+
+/* Scratch space, used with ZSWAP_LOCK held. */
+static void *lz_work;      /* For the compressor. */
+static uint8_t *zbuf;      /* Compressed page being stored. */
+static uint8_t *wb_buf;    /* Page being written back. */
+
+/* Statistics. */
+static long long store_cnt;     /* # of pages stored. */
+static long long store_bytes;   /* Their total compressed size. */
+static long long reject_cnt;    /* # of pages that did not compress. */
+static long long load_cnt;      /* # of pages loaded from the pool. */
+static long long writeback_cnt; /* # of pages written back to disk. */
+
+static uint64_t entry_hash(const struct hash_elem *e, void *aux UNUSED);
+static bool entry_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED);
+
+/* Sets up the pool. */
+void zswap_init(void) {
+    hash_init(&entries, entry_hash, entry_less, NULL);
+    list_init(&lru);
+    lock_init(&zswap_lock);
+    lz_work = palloc_get_multiple(PAL_ASSERT, DIV_ROUND_UP(LZ_WORK_SIZE, PGSIZE));
+    zbuf = palloc_get_page(PAL_ASSERT);
+    wb_buf = palloc_get_page(PAL_ASSERT);
+    enabled = true;
+}
+
+/* Returns the entry for SLOT, or a null pointer. */
+static struct zswap_entry *entry_find(size_t slot) {
+    struct zswap_entry key;
+    struct hash_elem *e;
+
+    key.slot = slot;
+    e = hash_find(&entries, &key.elem);
+    return e != NULL ? hash_entry(e, struct zswap_entry, elem) : NULL;
+}
+
+/* Removes ENTRY from the pool and frees it. */
+static void entry_remove(struct zswap_entry *entry) {
+    hash_delete(&entries, &entry->elem);
+    list_remove(&entry->lru_elem);
+    pool_bytes -= sizeof *entry + entry->size;
+    free(entry);
+}
+
+/* Writes the oldest page in the pool to its slot on disk and
+ * drops it from the pool. */
+static void writeback_oldest(void) {
+    struct zswap_entry *entry = list_entry(list_front(&lru), struct zswap_entry, lru_elem);
+
+    if (lz_decompress(entry->data, entry->size, wb_buf, PGSIZE) != PGSIZE)
+        PANIC("zswap: corrupt entry for slot %zu", entry->slot);
+    swap_write_slot(entry->slot, wb_buf);
+    entry_remove(entry);
+    writeback_cnt++;
+}
+
+/* Compresses the page at KVA into the pool as the contents of
+ * SLOT, writing older pages back to disk to make room if needed.
+ * Returns false if the page does not compress well enough, in
+ * which case the caller must write it to SLOT itself. */
+bool zswap_store(size_t slot, const void *kva) {
+    struct zswap_entry *entry = NULL;
+    size_t size;
+
+    if (!enabled)
+        return false;
+
+    lock_acquire(&zswap_lock);
+    size = lz_compress(kva, PGSIZE, zbuf, ZSWAP_MAX_ENTRY, lz_work);
+    if (size == 0)
+        reject_cnt++;
+    else {
+        while (pool_bytes + sizeof *entry + size > ZSWAP_MAX_BYTES && !list_empty(&lru))
+            writeback_oldest();
+        entry = malloc(sizeof *entry + size);
+    }
+    if (entry != NULL) {
+        entry->slot = slot;
+        entry->size = size;
+        memcpy(entry->data, zbuf, size);
+        hash_insert(&entries, &entry->elem);
+        list_push_back(&lru, &entry->lru_elem);
+        pool_bytes += sizeof *entry + size;
+        store_cnt++;
+        store_bytes += size;
+    }
+    lock_release(&zswap_lock);
+    return entry != NULL;
+}
+
+/* Decompresses SLOT's page into KVA and returns true, if the page
+ * is in the pool.  Returns false if it is not, in which case it
+ * is on disk. */
+bool zswap_load(size_t slot, void *kva) {
+    struct zswap_entry *entry;
+
+    if (!enabled)
+        return false;
+
+    lock_acquire(&zswap_lock);
+    entry = entry_find(slot);
+    if (entry != NULL) {
+        if (lz_decompress(entry->data, entry->size, kva, PGSIZE) != PGSIZE)
+            PANIC("zswap: corrupt entry for slot %zu", slot);
+        load_cnt++;
+    }
+    lock_release(&zswap_lock);
+    return entry != NULL;
+}
+
+/* Drops SLOT's page from the pool, if it is there. */
+void zswap_invalidate(size_t slot) {
+    struct zswap_entry *entry;
+
+    if (!enabled)
+        return;
+
+    lock_acquire(&zswap_lock);
+    entry = entry_find(slot);
+    if (entry != NULL)
+        entry_remove(entry);
+    lock_release(&zswap_lock);
+}
+
+/* Prints zswap statistics. */
+void zswap_print_stats(void) {
+    printf("Zswap: %lld pages stored in %lld bytes (%lld%%), %lld rejected, %lld loaded, %lld written back\n", store_cnt, store_bytes, store_cnt > 0 ? store_bytes * 100 / (store_cnt * PGSIZE) : 0, reject_cnt, load_cnt,
+           writeback_cnt);
+}
+
+/* Returns a hash value for entry E. */
+static uint64_t entry_hash(const struct hash_elem *e, void *aux UNUSED) {
+    const struct zswap_entry *entry = hash_entry(e, struct zswap_entry, elem);
+    return hash_int(entry->slot);
+}
+
+/* Returns true if entry A precedes entry B. */
+static bool entry_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED) { return hash_entry(a, struct zswap_entry, elem)->slot < hash_entry(b, struct zswap_entry, elem)->slot; }